@@ -0,0 +1,429 @@
+#include "accounts.h"
+#include "calendar.h"
+#include "database.h"
+#include "money.h"
+#include "log.h"
+#include <LittleFS.h>
+#include <unistd.h>
+
+#define VARINT_MAX_BYTES 5
+
+struct AccountSnapshot {
+  int32_t day;
+  uint8_t count;
+  AccountBalance balances[ACCOUNTS_MAX];
+};
+
+// balances collected during this wake
+static AccountSnapshot current;
+static bool currentComplete = false;
+
+// last complete snapshot of the current day, committed once the date rolls over (same scheme as the daily record)
+RTC_DATA_ATTR static AccountSnapshot staged;
+RTC_DATA_ATTR static bool hasStaged = false;
+
+static AccountIndexHeader header;
+static AccountColumn columns[ACCOUNTS_MAX];
+
+static void columnPath(char* path, size_t size, const char* key) {
+  snprintf(path, size, ACCOUNTS_DIR "/%s.col", key);
+}
+
+static uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static size_t encodeVarint(uint32_t value, uint8_t* out) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+static const AccountBalance* findStaged(const char* key) {
+  for (int i = 0; i < staged.count; i++) {
+    if (strcmp(staged.balances[i].key, key) == 0) {
+      return &staged.balances[i];
+    }
+  }
+  return nullptr;
+}
+
+// load the column index, an empty store if there is none
+static bool loadIndex() {
+  memset(&header, 0, sizeof(AccountIndexHeader));
+  header.magic = ACCOUNTS_MAGIC;
+
+  if (!LittleFS.exists(ACCOUNTS_INDEX_FILE)) {
+    return true;
+  }
+
+  File file = LittleFS.open(ACCOUNTS_INDEX_FILE, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  AccountIndexHeader stored;
+  bool ok = file.read((uint8_t*)&stored, sizeof(AccountIndexHeader)) == sizeof(AccountIndexHeader) && stored.magic == ACCOUNTS_MAGIC && stored.count <= ACCOUNTS_MAX;
+  ok = ok && file.read((uint8_t*)columns, stored.count * sizeof(AccountColumn)) == stored.count * sizeof(AccountColumn);
+  file.close();
+
+  if (!ok) {
+    LOG_ERROR("acct", "Account index is corrupt");
+    return false;
+  }
+
+  header = stored;
+  return true;
+}
+
+// write the index to a temporary file and rename it over the old one, this is the commit point
+static bool saveIndex() {
+  File file = LittleFS.open(ACCOUNTS_TEMP_FILE, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+
+  bool ok = file.write((uint8_t*)&header, sizeof(AccountIndexHeader)) == sizeof(AccountIndexHeader);
+  ok = ok && file.write((uint8_t*)columns, header.count * sizeof(AccountColumn)) == header.count * sizeof(AccountColumn);
+  file.close();
+
+  return ok && LittleFS.rename(ACCOUNTS_TEMP_FILE, ACCOUNTS_INDEX_FILE);
+}
+
+// append to a file after cutting off anything an interrupted commit left past the committed length
+static bool appendAt(const char* path, uint32_t committed, const uint8_t* data, size_t length) {
+  File file = LittleFS.open(path, FILE_READ);
+  size_t size = file ? file.size() : 0;
+  if (file) {
+    file.close();
+  }
+
+  if (size > committed) {
+    char fullPath[48];
+    snprintf(fullPath, sizeof(fullPath), DB_MOUNT_POINT "%s", path);
+    if (truncate(fullPath, committed) != 0) {
+      return false;
+    }
+  }
+
+  file = LittleFS.open(path, FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+  size_t written = file.write(data, length);
+  file.close();
+  return written == length;
+}
+
+// decode the varint ending a column (the last row's delta), continuation bytes carry the high bit
+// so it is found by stepping back from the end, at most VARINT_MAX_BYTES reads
+static bool readLastDelta(const AccountColumn& column, int32_t& delta, uint32_t& length) {
+  char path[32];
+  columnPath(path, sizeof(path), column.key);
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file || column.bytes == 0) {
+    if (file) {
+      file.close();
+    }
+    return false;
+  }
+
+  uint32_t start = column.bytes > VARINT_MAX_BYTES ? column.bytes - VARINT_MAX_BYTES : 0;
+  uint8_t tail[VARINT_MAX_BYTES];
+  file.seek(start);
+  int got = file.read(tail, column.bytes - start);
+  file.close();
+  if (got != (int)(column.bytes - start)) {
+    return false;
+  }
+
+  int first = got - 1;
+  while (first > 0 && (tail[first - 1] & 0x80)) {
+    first--;
+  }
+
+  uint32_t encoded = 0;
+  for (int i = first; i < got; i++) {
+    encoded |= (uint32_t)(tail[i] & 0x7F) << (7 * (i - first));
+  }
+  delta = unzigzag(encoded);
+  length = got - first;
+  return true;
+}
+
+// a column's value before its last row, 0 if the column starts there
+static int32_t previousValue(const AccountColumn& column) {
+  int32_t delta;
+  uint32_t length;
+  if (column.startRow >= header.rows - 1 || !readLastDelta(column, delta, length)) {
+    return 0;
+  }
+  return column.lastValue - delta;
+}
+
+/*
+  take the last committed row back out so the same day can be written again (a critical battery committed
+  it early and a later wake fetched newer balances), the index is saved without the row before anything is
+  appended, a crash in between only loses the row while the staged snapshot is still in RTC memory
+*/
+static bool dropLastRow() {
+  // columns are added in row order, the ones that started on the last row are at the end
+  while (header.count > 0 && columns[header.count - 1].startRow >= header.rows - 1) {
+    header.count--;
+  }
+
+  for (int i = 0; i < header.count; i++) {
+    int32_t delta;
+    uint32_t length;
+    if (!readLastDelta(columns[i], delta, length)) {
+      return false;
+    }
+    columns[i].lastValue -= delta;
+    columns[i].bytes -= length;
+  }
+
+  header.rows--;
+  header.lastDay = 0;
+  if (header.rows > 0) {
+    File days = LittleFS.open(ACCOUNTS_DAYS_FILE, FILE_READ);
+    bool ok = days && days.seek((header.rows - 1) * sizeof(int32_t)) && days.read((uint8_t*)&header.lastDay, sizeof(int32_t)) == sizeof(int32_t);
+    if (days) {
+      days.close();
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  return saveIndex();
+}
+
+void beginAccountSnapshot() {
+  current.day = 0;
+  current.count = 0;
+  currentComplete = false;
+}
+
+void recordAccountBalance(AccountSource source, uint32_t id, int64_t cents) {
+  if (current.count >= ACCOUNTS_MAX) {
+    LOG_WARN("acct", "More than %d accounts, not tracking %u", ACCOUNTS_MAX, (unsigned)id);
+    return;
+  }
+
+  AccountBalance& balance = current.balances[current.count++];
+  snprintf(balance.key, sizeof(balance.key), "%c%u", source == AccountSource::Manual ? 'a' : 'p', (unsigned)id);
+  balance.value = centsToDollars(cents);
+}
+
+void endAccountSnapshot(bool complete) {
+  currentComplete = complete;
+}
+
+bool stageAccountSnapshot(const char* date) {
+  int32_t day;
+  if (!currentComplete || !parseDayNumber(date, day)) {
+    return false;
+  }
+
+  if (hasStaged && staged.day != day && !commitAccountSnapshot()) {
+    return false;
+  }
+
+  staged = current;
+  staged.day = day;
+  hasStaged = true;
+  return true;
+}
+
+bool commitAccountSnapshot() {
+  if (!hasStaged) {
+    return true;
+  }
+
+  if (!loadIndex()) {
+    return false;
+  }
+
+  if (header.rows > 0 && staged.day < header.lastDay) {
+    LOG_WARN("acct", "Snapshot day %d is before %d, dropping it", (int)staged.day, (int)header.lastDay);
+    hasStaged = false;
+    return true;
+  }
+
+  // the day was already committed early, its row is replaced
+  if (header.rows > 0 && staged.day == header.lastDay && !dropLastRow()) {
+    LOG_ERROR("acct", "Failed to replace row %d", (int)header.rows - 1);
+    return false;
+  }
+
+  LittleFS.mkdir(ACCOUNTS_DIR);
+
+  if (!appendAt(ACCOUNTS_DAYS_FILE, header.rows * sizeof(int32_t), (const uint8_t*)&staged.day, sizeof(int32_t))) {
+    LOG_ERROR("acct", "Failed to append day index");
+    return false;
+  }
+
+  // every existing column gets a row, accounts missing today (closed or removed) drop to 0
+  char path[32];
+  uint8_t encoded[VARINT_MAX_BYTES];
+  bool ok = true;
+  for (int i = 0; i < header.count && ok; i++) {
+    AccountColumn& column = columns[i];
+    const AccountBalance* balance = findStaged(column.key);
+    int32_t value = balance ? balance->value : 0;
+
+    size_t length = encodeVarint(zigzag(value - column.lastValue), encoded);
+    columnPath(path, sizeof(path), column.key);
+    ok = appendAt(path, column.bytes, encoded, length);
+    column.lastValue = value;
+    column.bytes += length;
+  }
+
+  // accounts seen for the first time start a column at this row
+  for (int i = 0; i < staged.count && ok; i++) {
+    const AccountBalance& balance = staged.balances[i];
+    bool known = false;
+    for (int c = 0; c < header.count && !known; c++) {
+      known = strcmp(columns[c].key, balance.key) == 0;
+    }
+    if (known || header.count >= ACCOUNTS_MAX) {
+      continue;
+    }
+
+    AccountColumn& column = columns[header.count++];
+    memset(&column, 0, sizeof(AccountColumn));
+    strncpy(column.key, balance.key, ACCOUNT_KEY_LEN - 1);
+    column.startRow = header.rows;
+
+    size_t length = encodeVarint(zigzag(balance.value), encoded);
+    columnPath(path, sizeof(path), column.key);
+    ok = appendAt(path, 0, encoded, length);
+    column.lastValue = balance.value;
+    column.bytes = length;
+  }
+
+  header.rows++;
+  header.lastDay = staged.day;
+
+  if (!ok || !saveIndex()) {
+    LOG_ERROR("acct", "Failed to commit account balances");
+    return false;
+  }
+
+  hasStaged = false;
+  LOG_INFO("acct", "Committed %d account balances for row %d", header.count, (int)header.rows - 1);
+  return true;
+}
+
+int getAccountChanges(AccountChange* buffer, int maxChanges) {
+  if (!hasStaged || !loadIndex()) {
+    return 0;
+  }
+
+  // a day committed early is compared against the row before it
+  bool replacing = header.rows > 0 && staged.day == header.lastDay;
+
+  int count = 0;
+  for (int i = 0; i < staged.count; i++) {
+    const AccountBalance& balance = staged.balances[i];
+
+    int32_t previous = 0;
+    for (int c = 0; c < header.count; c++) {
+      if (strcmp(columns[c].key, balance.key) == 0) {
+        previous = replacing ? previousValue(columns[c]) : columns[c].lastValue;
+        break;
+      }
+    }
+
+    int32_t change = balance.value - previous;
+    if (change == 0) {
+      continue;
+    }
+
+    // insertion sort by size of the move, keeping the largest maxChanges
+    int position = min(count, maxChanges);
+    while (position > 0 && abs(buffer[position - 1].change) < abs(change)) {
+      if (position < maxChanges) {
+        buffer[position] = buffer[position - 1];
+      }
+      position--;
+    }
+    if (position < maxChanges) {
+      AccountChange& entry = buffer[position];
+      strncpy(entry.key, balance.key, ACCOUNT_KEY_LEN);
+      entry.value = balance.value;
+      entry.change = change;
+      count = min(count + 1, maxChanges);
+    }
+  }
+
+  return count;
+}
+
+int forEachAccountBalance(const char* key, const std::function<void(int32_t day, int32_t value)>& visit) {
+  if (!loadIndex()) {
+    return 0;
+  }
+
+  const AccountColumn* column = nullptr;
+  for (int i = 0; i < header.count; i++) {
+    if (strcmp(columns[i].key, key) == 0) {
+      column = &columns[i];
+      break;
+    }
+  }
+  if (!column) {
+    return 0;
+  }
+
+  char path[32];
+  columnPath(path, sizeof(path), key);
+  File days = LittleFS.open(ACCOUNTS_DAYS_FILE, FILE_READ);
+  File values = LittleFS.open(path, FILE_READ);
+  if (!days || !values) {
+    return 0;
+  }
+
+  days.seek(column->startRow * sizeof(int32_t));
+
+  int32_t value = 0;
+  uint32_t consumed = 0;
+  int visited = 0;
+  for (int row = column->startRow; row < header.rows && consumed < column->bytes; row++) {
+    int32_t day;
+    if (days.read((uint8_t*)&day, sizeof(int32_t)) != sizeof(int32_t)) {
+      break;
+    }
+
+    uint32_t encoded = 0;
+    int shift = 0;
+    int c;
+    do {
+      c = values.read();
+      if (c < 0) {
+        break;
+      }
+      encoded |= (uint32_t)(c & 0x7F) << shift;
+      shift += 7;
+      consumed++;
+    } while ((c & 0x80) && shift < 7 * VARINT_MAX_BYTES);
+    if (c < 0) {
+      break;
+    }
+
+    value += unzigzag(encoded);
+    visit(day, value);
+    visited++;
+  }
+
+  days.close();
+  values.close();
+  return visited;
+}
@@ -0,0 +1,77 @@
+#ifndef HELPERS_ACCOUNTS_H
+#define HELPERS_ACCOUNTS_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define ACCOUNTS_DIR "/acct"
+#define ACCOUNTS_DAYS_FILE ACCOUNTS_DIR "/days.dat" // shared row index, one int32 day number per committed day
+#define ACCOUNTS_INDEX_FILE ACCOUNTS_DIR "/index.dat"
+#define ACCOUNTS_TEMP_FILE ACCOUNTS_DIR "/index.tmp"
+#define ACCOUNTS_MAGIC 0x54434341 // "ACCT"
+#define ACCOUNTS_MAX 48 // accounts tracked, further accounts still count towards net worth but get no column
+#define ACCOUNT_KEY_LEN 12 // "a" (manual asset) or "p" (plaid account) + Lunch Money id
+
+enum class AccountSource : uint8_t {
+  Manual,
+  Plaid
+};
+
+// one account's signed balance (liabilities negative) in whole dollars
+struct AccountBalance {
+  char key[ACCOUNT_KEY_LEN];
+  int32_t value;
+};
+
+// an account's staged balance against its last committed one
+struct AccountChange {
+  char key[ACCOUNT_KEY_LEN];
+  int32_t value;
+  int32_t change;
+};
+
+/*
+  column bookkeeping, each account's balances live in ACCOUNTS_DIR/<key>.col as zigzag varint deltas
+  from the previous row, starting at startRow of the day index and continuing every committed day since
+*/
+struct AccountColumn {
+  char key[ACCOUNT_KEY_LEN];
+  int32_t startRow;
+  int32_t lastValue;
+  uint32_t bytes; // committed column length, anything past it is a torn append and is cut off
+};
+
+struct AccountIndexHeader {
+  uint32_t magic;
+  int32_t rows; // committed days, the day index file holds exactly this many entries
+  int32_t lastDay;
+  uint16_t count;
+  uint16_t reserved;
+};
+
+// start collecting balances for this wake
+void beginAccountSnapshot();
+
+// add an account balance to the snapshot
+void recordAccountBalance(AccountSource source, uint32_t id, int64_t cents);
+
+// finish the snapshot, an incomplete one (a request failed) is never staged
+void endAccountSnapshot(bool complete);
+
+// stage the snapshot as the balances for a date (format: "MM-DD-YYYY") in RTC memory
+// the previously staged day is committed first if the date moved on
+bool stageAccountSnapshot(const char* date);
+
+// append the staged day to the day index and every column, one append per file
+// a day already committed (early, on a critical battery) has its row replaced, an older day is dropped
+bool commitAccountSnapshot();
+
+// staged balances that changed since the last committed day, largest moves first
+// returns the number of changes written to buffer
+int getAccountChanges(AccountChange* buffer, int maxChanges);
+
+// call visit for every committed (day number, balance) of an account, oldest first
+// returns the number of rows visited
+int forEachAccountBalance(const char* key, const std::function<void(int32_t day, int32_t value)>& visit);
+
+#endif
@@ -1,175 +1,249 @@
 #include "api.h"
 #include "format.h"
+#include "log.h"
+#include "fetch.h"
+#include "money.h"
+#include "arena.h"
+#include "accounts.h"
+#include "classify.h"
+#include "plaidsync.h"
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
-#include "../credentials.h"
 
 #define LUNCH_MONEY_ASSETS_URL "https://dev.lunchmoney.app/v1/assets"
 #define LUNCH_MONEY_PLAID_URL "https://dev.lunchmoney.app/v1/plaid_accounts"
+#define LUNCH_MONEY_TRANSACTIONS_URL "https://dev.lunchmoney.app/v1/transactions"
 #define GOLD_API_URL "https://api.gold-api.com/price/XAU"
 #define BITCOIN_API_URL "https://api.coingecko.com/api/v3/simple/price?ids=bitcoin&vs_currencies=usd"
 
-String fetchLunchMoneyEndpoint(const char* url) {
-  HTTPClient http;
+// stream a response body straight into doc, returns false on request or parse failure
+// with a filter, fields it doesn't name are skipped by the parser without being stored
+static bool fetchJson(const FetchRequest& request, JsonDocument& doc, const char* label, JsonDocument* filter = nullptr) {
+  DeserializationError error;
 
-  http.begin(url);
-  http.addHeader("Authorization", String("Bearer ") + LUNCH_MONEY_ACCESS_TOKEN);
-  http.addHeader("Content-Type", "application/json");
-
-  int httpCode = http.GET();
+  int httpCode = fetchWithRetry(request, [&](Stream& body) {
+    if (filter) {
+      error = deserializeJson(doc, body, DeserializationOption::Filter(*filter));
+    } else {
+      error = deserializeJson(doc, body);
+    }
+    // a truncated body is worth another attempt, a malformed one is not
+    return error != DeserializationError::IncompleteInput;
+  });
 
   if (httpCode != HTTP_CODE_OK) {
-    Serial.printf("HTTP GET %s failed, code: %d\n", url, httpCode);
-    http.end();
-    return "";
+    LOG_WARN("api", "%s request failed, code: %d", label, httpCode);
+    return false;
+  }
+
+  if (error) {
+    LOG_WARN("api", "%s JSON parse error: %s", label, error.c_str());
+    return false;
   }
 
-  String payload = http.getString();
-  http.end();
-  return payload;
+  return true;
 }
 
-int32_t fetchNetWorth() {
-  double totalNetWorth = 0.0;
+static bool fetchLunchMoneyEndpoint(FetchEndpoint endpoint, const char* url, JsonDocument& doc, const char* label, JsonDocument* filter = nullptr) {
+  FetchRequest request = { endpoint, url, true, false };
+  return fetchJson(request, doc, label, filter);
+}
 
-  // get manual assets
-  Serial.println("Getting manual assets from Lunch Money...");
-  String assetsPayload = fetchLunchMoneyEndpoint(LUNCH_MONEY_ASSETS_URL);
+// account balance in cents, preferring to_base (converted to the primary currency) when present
+static int64_t getBalanceCents(JsonObject account) {
+  int64_t cents = 0;
+  JsonVariant toBase = account["to_base"];
+
+  if (toBase.isNull()) {
+    parseCents(account["balance"], cents);
+  } else if (toBase.is<const char*>()) {
+    parseCents(toBase.as<const char*>(), cents);
+  } else if (toBase.is<int64_t>()) {
+    cents = toBase.as<int64_t>() * 100;
+  } else {
+    // ArduinoJson has already parsed fractional numbers as a double
+    cents = doubleToCents(toBase.as<double>());
+  }
 
-  if (assetsPayload.length() > 0) {
-    JsonDocument assetsDoc;
-    DeserializationError error = deserializeJson(assetsDoc, assetsPayload);
+  return cents;
+}
 
-    if (error) {
-      Serial.printf("Assets JSON parse error: %s\n", error.c_str());
-    } else {
-      JsonArray assets = assetsDoc["assets"].as<JsonArray>();
-
-      for (JsonObject asset : assets) {
-        const char* typeName = asset["type_name"];
-        const char* name = asset["name"];
-        const char* balanceStr = asset["balance"];
-
-        if (!asset["closed_on"].isNull()) {
-          Serial.printf("  Skipping closed asset: %s\n", name);
-          continue;
-        }
-
-        double balance = atof(balanceStr);
-
-        if (!asset["to_base"].isNull()) {
-          balance = asset["to_base"].as<double>();
-        }
-
-        bool isLiability = (
-          strcmp(typeName, "loan") == 0 ||
-          strcmp(typeName, "credit") == 0 ||
-          strcmp(typeName, "other liability") == 0
-        );
-
-        if (isLiability) {
-          totalNetWorth -= abs(balance);
-        } else {
-          totalNetWorth += balance;
-        }
-      }
+// field names differ between the two Lunch Money account lists
+struct AccountFields {
+  AccountSource source;
+  const char* type;
+  const char* subtype;
+  bool incremental; // keep a running total adjusted by the accounts that moved (see plaidsync.h)
+};
+
+static const AccountFields manualFields = { AccountSource::Manual, "type_name", "subtype_name", false };
+static const AccountFields plaidFields = { AccountSource::Plaid, "type", "subtype", true };
+
+// classify by type, falling back to the subtype when the type is generic (e.g. "other")
+static AccountType getAccountType(JsonObject account, const AccountFields& fields) {
+  AccountType type = classifyAccountType(account[fields.type]);
+  if (type == AccountType::Other || type == AccountType::Unknown) {
+    AccountType subtype = classifyAccountType(account[fields.subtype]);
+    if (subtype != AccountType::Unknown) {
+      return subtype;
     }
   }
+  return type;
+}
 
-  // get plaid-synced accounts
-  Serial.println("Getting Plaid accounts from Lunch Money...");
-  String plaidPayload = fetchLunchMoneyEndpoint(LUNCH_MONEY_PLAID_URL);
+// sum accounts in cents, subtracting liabilities
+static int64_t sumAccounts(JsonArray accounts, const AccountFields& fields) {
+  int64_t total = 0;
+  if (fields.incremental) {
+    beginPlaidSync();
+  }
 
-  if (plaidPayload.length() > 0) {
-    JsonDocument plaidDoc;
-    DeserializationError error = deserializeJson(plaidDoc, plaidPayload);
+  for (JsonObject account : accounts) {
+    if (!account["closed_on"].isNull()) {
+      LOG_DEBUG("api", "Skipping closed account: %s", account["name"].as<const char*>());
+      continue;
+    }
 
-    if (error) {
-      Serial.printf("Plaid JSON parse error: %s\n", error.c_str());
-    } else {
-      JsonArray accounts = plaidDoc["plaid_accounts"].as<JsonArray>();
+    uint32_t id = account["id"].as<uint32_t>();
+    int64_t balance = getBalanceCents(account);
+    int64_t signedBalance = isLiabilityType(getAccountType(account, fields)) ? -llabs(balance) : balance;
+    if (fields.incremental) {
+      syncPlaidBalance(id, signedBalance);
+    }
+
+    recordAccountBalance(fields.source, id, signedBalance);
+    total += signedBalance;
+  }
+
+  // the synced total was only adjusted by the accounts that moved
+  return fields.incremental ? endPlaidSync() : total;
+}
+
+int32_t fetchNetWorth() {
+  int64_t totalCents = 0;
+  bool assetsOk = false;
+  bool plaidOk = false;
 
-      for (JsonObject account : accounts) {
-        const char* type = account["type"];
-        const char* name = account["name"];
-        const char* balanceStr = account["balance"];
+  // per-account balances are kept alongside the total (see accounts.h)
+  beginAccountSnapshot();
 
-        double balance = atof(balanceStr);
+  // each document is scoped so the next one reuses the same arena memory
 
-        if (!account["to_base"].isNull()) {
-          balance = account["to_base"].as<double>();
-        }
+  // get manual assets
+  LOG_INFO("api", "Getting manual assets from Lunch Money...");
+  {
+    JsonDocument assetsDoc(&jsonArena);
+    assetsOk = fetchLunchMoneyEndpoint(FetchEndpoint::Assets, LUNCH_MONEY_ASSETS_URL, assetsDoc, "Assets");
+    if (assetsOk) {
+      totalCents += sumAccounts(assetsDoc["assets"].as<JsonArray>(), manualFields);
+    }
+  }
 
-        bool isLiability = (strcmp(type, "credit") == 0 || strcmp(type, "loan") == 0);
+  // get plaid-synced accounts
+  LOG_INFO("api", "Getting Plaid accounts from Lunch Money...");
+  {
+    // only the fields the sum needs are kept, the rest of each object is skipped
+    JsonDocument plaidFilter(&jsonArena);
+    JsonObject fields = plaidFilter["plaid_accounts"].add<JsonObject>();
+    for (const char* field : { "id", "type", "subtype", "balance", "to_base", "closed_on" }) {
+      fields[field] = true;
+    }
 
-        if (isLiability) {
-          totalNetWorth -= abs(balance);
-        } else {
-          totalNetWorth += balance;
-        }
-      }
+    JsonDocument plaidDoc(&jsonArena);
+    plaidOk = fetchLunchMoneyEndpoint(FetchEndpoint::Plaid, LUNCH_MONEY_PLAID_URL, plaidDoc, "Plaid", &plaidFilter);
+    if (plaidOk) {
+      totalCents += sumAccounts(plaidDoc["plaid_accounts"].as<JsonArray>(), plaidFields);
     }
   }
 
-  return (int32_t)round(totalNetWorth);
+  endAccountSnapshot(assetsOk && plaidOk);
+  return centsToDollars(totalCents);
 }
 
-String fetchGoldPrice() {
-  HTTPClient http;
-  http.begin(GOLD_API_URL);
-
-  int httpCode = http.GET();
+int fetchTransactionPage(
+  const char* startDate,
+  const char* endDate,
+  int offset,
+  bool& hasMore,
+  const std::function<void(const char* date, int64_t cents)>& visit
+) {
+  char url[160];
+  snprintf(
+    url,
+    sizeof(url),
+    LUNCH_MONEY_TRANSACTIONS_URL "?start_date=%s&end_date=%s&offset=%d&limit=%d",
+    startDate,
+    endDate,
+    offset,
+    TRANSACTION_PAGE_SIZE
+  );
+
+  JsonDocument filter(&jsonArena);
+  JsonObject fields = filter["transactions"].add<JsonObject>();
+  for (const char* field : { "date", "amount", "to_base", "status", "asset_id", "plaid_account_id" }) {
+    fields[field] = true;
+  }
+  filter["has_more"] = true;
 
-  if (httpCode != HTTP_CODE_OK) {
-    Serial.printf("Gold API request failed, code: %d\n", httpCode);
-    http.end();
-    return "N/A";
+  JsonDocument doc(&jsonArena);
+  if (!fetchLunchMoneyEndpoint(FetchEndpoint::Transactions, url, doc, "Transactions", &filter)) {
+    return -1;
   }
 
-  String payload = http.getString();
-  http.end();
+  JsonArray transactions = doc["transactions"].as<JsonArray>();
+  for (JsonObject transaction : transactions) {
+    // pending transactions aren't in any balance yet, and ones without an account never touched a tracked balance
+    const char* status = transaction["status"];
+    if ((status && strcmp(status, "pending") == 0) || (transaction["asset_id"].isNull() && transaction["plaid_account_id"].isNull())) {
+      continue;
+    }
 
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, payload);
+    // Lunch Money amounts are debits, an expense is positive
+    JsonVariant amount = transaction["to_base"].isNull() ? transaction["amount"] : transaction["to_base"];
+    int64_t cents = 0;
+    if (amount.is<const char*>()) {
+      parseCents(amount.as<const char*>(), cents);
+    } else {
+      cents = doubleToCents(amount.as<double>());
+    }
 
-  if (error) {
-    Serial.printf("Gold API JSON parse error: %s\n", error.c_str());
-    return "N/A";
+    visit(transaction["date"], -cents);
   }
 
-  double price = doc["price"].as<double>();
-  int32_t wholePrice = (int32_t)round(price);
-
-  Serial.printf("Gold price: $%d\n", wholePrice);
-  return formatCurrency(wholePrice);
+  // older API versions don't send has_more, a full page means there may be another
+  JsonVariant more = doc["has_more"];
+  hasMore = more.is<bool>() ? more.as<bool>() : transactions.size() >= TRANSACTION_PAGE_SIZE;
+  return transactions.size();
 }
 
-String fetchBitcoinPrice() {
-  HTTPClient http;
-  http.begin(BITCOIN_API_URL);
-
-  int httpCode = http.GET();
+bool fetchGoldPrice(char* buffer, size_t size) {
+  FetchRequest request = { FetchEndpoint::Gold, GOLD_API_URL, false, true };
+  JsonDocument doc(&jsonArena);
 
-  if (httpCode != HTTP_CODE_OK) {
-    Serial.printf("Bitcoin API request failed, code: %d\n", httpCode);
-    http.end();
-    return "N/A";
+  if (!fetchJson(request, doc, "Gold API")) {
+    return false;
   }
 
-  String payload = http.getString();
-  http.end();
+  double price = doc["price"].as<double>();
+  int32_t wholePrice = (int32_t)round(price);
 
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, payload);
+  LOG_INFO("api", "Gold price: $%d", wholePrice);
+  formatCurrency(buffer, size, wholePrice);
+  return true;
+}
 
-  if (error) {
-    Serial.printf("Bitcoin API JSON parse error: %s\n", error.c_str());
-    return "N/A";
+bool fetchBitcoinPrice(char* buffer, size_t size) {
+  FetchRequest request = { FetchEndpoint::Bitcoin, BITCOIN_API_URL, false, true };
+  JsonDocument doc(&jsonArena);
+
+  if (!fetchJson(request, doc, "Bitcoin API")) {
+    return false;
   }
 
   double price = doc["bitcoin"]["usd"].as<double>();
   int32_t wholePrice = (int32_t)round(price);
 
-  Serial.printf("Bitcoin price: $%d\n", wholePrice);
-  return formatCurrency(wholePrice);
+  LOG_INFO("api", "Bitcoin price: $%d", wholePrice);
+  formatCurrency(buffer, size, wholePrice);
+  return true;
 }
@@ -2,17 +2,31 @@
 #define HELPERS_API_H
 
 #include <Arduino.h>
+#include <functional>
+
+#define TRANSACTION_PAGE_SIZE 100
 
 // fetches all assets from Lunch Money API and calculates total net worth
 // returns the net worth in whole dollars (rounded) or 0 on error
 int32_t fetchNetWorth();
 
+// fetches one page of transactions dated between startDate and endDate inclusive ("YYYY-MM-DD")
+// visit is called with each settled transaction's date and its effect on net worth in cents (income positive)
+// returns the number of transactions in the page or -1 on error, hasMore is set if another page follows
+int fetchTransactionPage(
+  const char* startDate,
+  const char* endDate,
+  int offset,
+  bool& hasMore,
+  const std::function<void(const char* date, int64_t cents)>& visit
+);
+
 // fetches current gold price from gold-api.com
-// returns price as "$XXXX" string or "N/A" on error
-String fetchGoldPrice();
+// writes the price as "$XXXX" into buffer, returns false (buffer untouched) on error
+bool fetchGoldPrice(char* buffer, size_t size);
 
 // fetches current Bitcoin price from CoinGecko
-// returns price as "$XXXXX" string or "N/A" on error
-String fetchBitcoinPrice();
+// writes the price as "$XXXXX" into buffer, returns false (buffer untouched) on error
+bool fetchBitcoinPrice(char* buffer, size_t size);
 
 #endif
@@ -0,0 +1,106 @@
+#include "arena.h"
+#include "log.h"
+
+// each block is prefixed with its size so it can be copied on reallocate
+#define BLOCK_HEADER 8
+#define ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+JsonArena jsonArena;
+
+bool JsonArena::reserve() {
+  if (!base) {
+    base = (uint8_t*)(psramFound() ? ps_malloc(JSON_ARENA_SIZE) : malloc(JSON_ARENA_SIZE));
+    if (!base) {
+      LOG_ERROR("arena", "Could not reserve %u byte JSON arena", (unsigned)JSON_ARENA_SIZE);
+    }
+  }
+  return base != nullptr;
+}
+
+bool JsonArena::owns(void* ptr) const {
+  return base && (uint8_t*)ptr >= base && (uint8_t*)ptr < base + JSON_ARENA_SIZE;
+}
+
+void* JsonArena::allocate(size_t size) {
+  size_t needed = BLOCK_HEADER + ALIGN(size);
+
+  if (!reserve() || offset + needed > JSON_ARENA_SIZE) {
+    spilled += size;
+    return malloc(size);
+  }
+
+  uint8_t* block = base + offset;
+  *(uint32_t*)block = size;
+  offset += needed;
+  peak = max(peak, offset);
+  live++;
+
+  last = block + BLOCK_HEADER;
+  return last;
+}
+
+void JsonArena::deallocate(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  if (!owns(ptr)) {
+    free(ptr);
+    return;
+  }
+
+  if (ptr == last) {
+    offset = (uint8_t*)ptr - BLOCK_HEADER - base;
+    last = nullptr;
+  }
+
+  // everything released, start over from the beginning
+  if (--live == 0) {
+    offset = 0;
+    last = nullptr;
+  }
+}
+
+void* JsonArena::reallocate(void* ptr, size_t newSize) {
+  if (!ptr) {
+    return allocate(newSize);
+  }
+
+  if (!owns(ptr)) {
+    return realloc(ptr, newSize);
+  }
+
+  uint8_t* block = (uint8_t*)ptr - BLOCK_HEADER;
+  size_t oldSize = *(uint32_t*)block;
+
+  // the latest block can grow or shrink in place
+  size_t start = block - base;
+  if (ptr == last && start + BLOCK_HEADER + ALIGN(newSize) <= JSON_ARENA_SIZE) {
+    *(uint32_t*)block = newSize;
+    offset = start + BLOCK_HEADER + ALIGN(newSize);
+    peak = max(peak, offset);
+    return ptr;
+  }
+
+  if (newSize <= oldSize) {
+    return ptr;
+  }
+
+  void* moved = allocate(newSize);
+  if (moved) {
+    memcpy(moved, ptr, oldSize);
+    deallocate(ptr);
+  }
+  return moved;
+}
+
+void logJsonArena() {
+  // short enough for LOG_MSG_LEN, at WARN so release builds keep it
+  LOG_WARN(
+    "arena",
+    "peak %u of %u bytes, %u spilled to heap",
+    (unsigned)jsonArena.highWaterMark(),
+    (unsigned)jsonArena.capacity(),
+    (unsigned)jsonArena.spilledBytes()
+  );
+}
@@ -0,0 +1,44 @@
+#ifndef HELPERS_ARENA_H
+#define HELPERS_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define JSON_ARENA_SIZE (64 * 1024) // bytes reserved once per wake for all JSON documents
+
+// bump allocator for JsonDocument, pass &jsonArena to the document constructor
+// the arena is reserved once (PSRAM when available) and rewinds automatically when every block
+// has been released, so documents created one after another reuse the same memory instead of
+// fragmenting the heap. Requests that don't fit spill over to the regular heap.
+class JsonArena : public ArduinoJson::Allocator {
+ public:
+  void* allocate(size_t size) override;
+  void deallocate(void* ptr) override;
+  void* reallocate(void* ptr, size_t newSize) override;
+
+  // most bytes in use at once since boot
+  size_t highWaterMark() const { return peak; }
+
+  // bytes that did not fit and went to the heap instead
+  size_t spilledBytes() const { return spilled; }
+
+  size_t capacity() const { return JSON_ARENA_SIZE; }
+
+ private:
+  bool reserve();
+  bool owns(void* ptr) const;
+
+  uint8_t* base = nullptr;
+  size_t offset = 0;
+  size_t peak = 0;
+  size_t spilled = 0;
+  size_t live = 0; // blocks currently allocated in the arena
+  void* last = nullptr; // most recent block, the only one that can grow in place
+};
+
+extern JsonArena jsonArena;
+
+// write the arena high-water mark to the log
+void logJsonArena();
+
+#endif
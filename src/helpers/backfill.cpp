@@ -0,0 +1,206 @@
+#include "backfill.h"
+#include "api.h"
+#include "calendar.h"
+#include "database.h"
+#include "fetch.h"
+#include "money.h"
+#include "log.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <unistd.h>
+
+/*
+  Lunch Money has no balance history, so the days before the first record are reconstructed from
+  transactions: walking backwards from today's net worth, each day's value is the next day's value
+  minus that day's income and spending. Market moves of investment accounts aren't transactions, so
+  the curve is an approximation that converges on the real one from today onwards.
+*/
+
+static_assert(BACKFILL_WINDOW_DAYS <= DB_READ_CHUNK, "a window is handed to the database as one chunk");
+
+static BackfillState state;
+
+static uint32_t stateCrc() {
+  return esp_rom_crc32_le(0, (const uint8_t*)&state, offsetof(BackfillState, crc));
+}
+
+static bool loadState() {
+  File file = LittleFS.open(BACKFILL_STATE_FILE, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  bool ok = file.read((uint8_t*)&state, sizeof(BackfillState)) == sizeof(BackfillState);
+  file.close();
+  return ok && state.magic == BACKFILL_MAGIC && state.crc == stateCrc();
+}
+
+static bool saveState() {
+  state.crc = stateCrc();
+
+  File file = LittleFS.open(BACKFILL_STATE_FILE, FILE_WRITE);
+  if (!file) {
+    LOG_ERROR("backfill", "Failed to open state");
+    return false;
+  }
+
+  size_t written = file.write((uint8_t*)&state, sizeof(BackfillState));
+  file.close();
+  return written == sizeof(BackfillState);
+}
+
+bool startBackfill(const char* today, int32_t netWorth) {
+  int32_t day;
+  if (LittleFS.exists(BACKFILL_STATE_FILE) || getRecordCount() > 1 || !parseDayNumber(today, day)) {
+    return false;
+  }
+
+  memset(&state, 0, sizeof(BackfillState));
+  state.magic = BACKFILL_MAGIC;
+  state.status = BackfillStatus::Running;
+  state.stopDay = day - BACKFILL_DAYS;
+  state.cursorDay = day;
+  state.runningCents = (int64_t)netWorth * 100;
+
+  LittleFS.remove(BACKFILL_DATA_FILE);
+  LOG_INFO("backfill", "Reconstructing %d days of history", BACKFILL_DAYS);
+  return saveState();
+}
+
+bool isBackfillRunning() {
+  return loadState() && state.status == BackfillStatus::Running;
+}
+
+// append a finished window (oldest day first) after cutting off anything a torn write left behind
+static bool appendWindow(const DailyNetWorth* records, int count) {
+  File file = LittleFS.open(BACKFILL_DATA_FILE, FILE_READ);
+  size_t size = file ? file.size() : 0;
+  if (file) {
+    file.close();
+  }
+
+  size_t committed = state.records * sizeof(DailyNetWorth);
+  if (size > committed && truncate(DB_MOUNT_POINT BACKFILL_DATA_FILE, committed) != 0) {
+    return false;
+  }
+
+  file = LittleFS.open(BACKFILL_DATA_FILE, FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+
+  size_t written = file.write((uint8_t*)records, count * sizeof(DailyNetWorth));
+  file.close();
+  return written == count * sizeof(DailyNetWorth);
+}
+
+// turn the window's per-day changes into values and store them, then move the cursor before the window
+static bool finishWindow(int32_t windowStart) {
+  int days = state.cursorDay - windowStart + 1;
+  DailyNetWorth records[BACKFILL_WINDOW_DAYS];
+  memset(records, 0, sizeof(records));
+
+  // records[i] is the end of day windowStart + i - 1, i.e. the next day's value minus the next day's change
+  int64_t value = state.runningCents;
+  for (int i = days - 1; i >= 0; i--) {
+    value -= state.changes[i];
+    formatDayNumber(records[i].date, DATE_LEN, windowStart + i - 1);
+    records[i].netWorth = centsToDollars(value);
+  }
+
+  if (!appendWindow(records, days)) {
+    LOG_ERROR("backfill", "Failed to write window");
+    return false;
+  }
+
+  state.cursorDay = windowStart - 1;
+  state.runningCents = value;
+  state.offset = 0;
+  state.windows++;
+  state.records += days;
+  memset(state.changes, 0, sizeof(state.changes));
+  return saveState();
+}
+
+// hand the windows to the database oldest first, which is the reverse of the order they were written
+static bool mergeHistory() {
+  File file = LittleFS.open(BACKFILL_DATA_FILE, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  int window = state.windows;
+  int added = prependNetWorthHistory([&](DailyNetWorth* chunk, int maxRecords) {
+    if (window == 0) {
+      return 0;
+    }
+    window--;
+
+    // only the oldest (last written) window can be short
+    int count = window == state.windows - 1 ? state.records - window * BACKFILL_WINDOW_DAYS : BACKFILL_WINDOW_DAYS;
+    count = min(count, maxRecords);
+    file.seek(window * BACKFILL_WINDOW_DAYS * sizeof(DailyNetWorth));
+    return (int)(file.read((uint8_t*)chunk, count * sizeof(DailyNetWorth)) / sizeof(DailyNetWorth));
+  });
+  file.close();
+
+  if (added < 0) {
+    return false;
+  }
+
+  state.status = BackfillStatus::Done;
+  LittleFS.remove(BACKFILL_DATA_FILE);
+  return saveState();
+}
+
+bool runBackfill() {
+  if (!loadState() || state.status != BackfillStatus::Running) {
+    return true;
+  }
+
+  while (getFetchBudgetRemaining() > BACKFILL_RESERVE_MS) {
+    if (state.cursorDay <= state.stopDay) {
+      if (!mergeHistory()) {
+        LOG_ERROR("backfill", "Failed to merge history");
+        return false;
+      }
+      LOG_INFO("backfill", "History complete");
+      return true;
+    }
+
+    int32_t windowStart = max(state.cursorDay - BACKFILL_WINDOW_DAYS + 1, state.stopDay + 1);
+    char startDate[DATE_LEN];
+    char endDate[DATE_LEN];
+    formatIsoDayNumber(startDate, sizeof(startDate), windowStart);
+    formatIsoDayNumber(endDate, sizeof(endDate), state.cursorDay);
+
+    bool hasMore = false;
+    int32_t cursorDay = state.cursorDay;
+    int count = fetchTransactionPage(startDate, endDate, state.offset, hasMore, [&](const char* date, int64_t cents) {
+      int32_t day;
+      if (parseIsoDayNumber(date, day) && day >= windowStart && day <= cursorDay) {
+        state.changes[day - windowStart] += cents;
+      }
+    });
+
+    // a failed page added nothing, it is fetched again next wake
+    if (count < 0) {
+      return false;
+    }
+
+    state.offset += count;
+    if (hasMore) {
+      if (!saveState()) {
+        return false;
+      }
+      continue;
+    }
+
+    if (!finishWindow(windowStart)) {
+      return false;
+    }
+    LOG_DEBUG("backfill", "Reconstructed back to %s", startDate);
+  }
+
+  return false;
+}
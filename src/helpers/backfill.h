@@ -0,0 +1,50 @@
+#ifndef HELPERS_BACKFILL_H
+#define HELPERS_BACKFILL_H
+
+#include <Arduino.h>
+
+#define BACKFILL_STATE_FILE "/backfill.state"
+#define BACKFILL_DATA_FILE "/backfill.dat" // reconstructed windows, newest window first
+#define BACKFILL_MAGIC 0x4C464B42 // "BKFL"
+#define BACKFILL_WINDOW_DAYS 31 // days of transactions reconstructed per window
+#define BACKFILL_RESERVE_MS 5000 // stop paging once less of the wake's network budget remains
+
+// days of history to reconstruct on a fresh device
+#ifndef BACKFILL_DAYS
+  #define BACKFILL_DAYS 365
+#endif
+
+enum class BackfillStatus : uint8_t {
+  Running,
+  Done
+};
+
+/*
+  progress survives across wakes (and power loss) in BACKFILL_STATE_FILE, the window being paged
+  keeps its per-day totals here so an interrupted page is simply fetched again
+*/
+struct BackfillState {
+  uint32_t magic;
+  BackfillStatus status;
+  int32_t stopDay; // oldest day to reconstruct
+  int32_t cursorDay; // runningCents is the net worth at the end of this day
+  int64_t runningCents;
+  int32_t offset; // transactions already read from the current window
+  int32_t windows; // windows written to BACKFILL_DATA_FILE
+  int32_t records; // records written to BACKFILL_DATA_FILE, anything past this is a torn write
+  int64_t changes[BACKFILL_WINDOW_DAYS]; // net worth change per day of the current window, in cents
+  uint32_t crc; // crc32 of the bytes above
+};
+
+// start reconstructing history backwards from today's value, only on a device with no earlier records
+// returns false if there is history already or a backfill was started before
+bool startBackfill(const char* today, int32_t netWorth);
+
+// fetch transaction pages while the wake's network budget lasts, merging the history into the database once complete
+// returns true when the backfill is done (or there is none)
+bool runBackfill();
+
+// true while a backfill still has pages to fetch
+bool isBackfillRunning();
+
+#endif
@@ -0,0 +1,76 @@
+#include "calendar.h"
+
+/*
+  day number conversions use Howard Hinnant's days_from_civil algorithm,
+  which works in 400 year eras so it needs no tables or loops
+*/
+
+int32_t daysFromCivil(int year, int month, int day) {
+  year -= month <= 2;
+  int32_t era = (year >= 0 ? year : year - 399) / 400;
+  int32_t yearOfEra = year - era * 400;
+  int32_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+void civilFromDays(int32_t dayNumber, int& year, int& month, int& day) {
+  dayNumber += 719468;
+  int32_t era = (dayNumber >= 0 ? dayNumber : dayNumber - 146096) / 146097;
+  int32_t dayOfEra = dayNumber - era * 146097;
+  int32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  int32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  int32_t mp = (5 * dayOfYear + 2) / 153;
+  day = dayOfYear - (153 * mp + 2) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = yearOfEra + era * 400 + (month <= 2);
+}
+
+bool parseDayNumber(const char* date, int32_t& dayNumber) {
+  int month, day, year;
+  if (!date || sscanf(date, "%2d-%2d-%4d", &month, &day, &year) != 3) {
+    return false;
+  }
+
+  // rejects "00-00-0000", written when the clock never synced
+  if (year < 1970 || month < 1 || month > 12 || day < 1 || day > 31) {
+    return false;
+  }
+
+  dayNumber = daysFromCivil(year, month, day);
+  return true;
+}
+
+bool parseIsoDayNumber(const char* date, int32_t& dayNumber) {
+  int month, day, year;
+  if (!date || sscanf(date, "%4d-%2d-%2d", &year, &month, &day) != 3) {
+    return false;
+  }
+
+  if (year < 1970 || month < 1 || month > 12 || day < 1 || day > 31) {
+    return false;
+  }
+
+  dayNumber = daysFromCivil(year, month, day);
+  return true;
+}
+
+const char* formatDayNumber(char* buffer, size_t size, int32_t dayNumber) {
+  int year, month, day;
+  civilFromDays(dayNumber, year, month, day);
+  snprintf(buffer, size, "%02d-%02d-%04d", month, day, year);
+  return buffer;
+}
+
+const char* formatIsoDayNumber(char* buffer, size_t size, int32_t dayNumber) {
+  int year, month, day;
+  civilFromDays(dayNumber, year, month, day);
+  snprintf(buffer, size, "%04d-%02d-%02d", year, month, day);
+  return buffer;
+}
+
+int weekdayOf(int32_t dayNumber) {
+  // 1970-01-01 was a Thursday
+  int32_t weekday = (dayNumber + 3) % 7;
+  return weekday < 0 ? weekday + 7 : weekday;
+}
@@ -0,0 +1,27 @@
+#ifndef HELPERS_CALENDAR_H
+#define HELPERS_CALENDAR_H
+
+#include <Arduino.h>
+
+// days since 1970-01-01 for a civil date (proleptic Gregorian)
+int32_t daysFromCivil(int year, int month, int day);
+
+// civil date for a day number
+void civilFromDays(int32_t dayNumber, int& year, int& month, int& day);
+
+// parse a "MM-DD-YYYY" date into a day number, returns false if malformed
+bool parseDayNumber(const char* date, int32_t& dayNumber);
+
+// parse an ISO "YYYY-MM-DD" date (as used by the Lunch Money API) into a day number, returns false if malformed
+bool parseIsoDayNumber(const char* date, int32_t& dayNumber);
+
+// format a day number as "MM-DD-YYYY"
+const char* formatDayNumber(char* buffer, size_t size, int32_t dayNumber);
+
+// format a day number as ISO "YYYY-MM-DD"
+const char* formatIsoDayNumber(char* buffer, size_t size, int32_t dayNumber);
+
+// day of the week, 0 = Monday
+int weekdayOf(int32_t dayNumber);
+
+#endif
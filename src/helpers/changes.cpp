@@ -0,0 +1,97 @@
+#include "changes.h"
+#include "database.h"
+#include "calendar.h"
+
+// day whose closing value the window compares against
+static int32_t windowStart(ChangeWindow window, int32_t latestDay) {
+  switch (window) {
+    case ChangeWindow::Day:
+      return latestDay - 1;
+    case ChangeWindow::Week:
+      return latestDay - 7;
+    case ChangeWindow::Month:
+      return latestDay - 30;
+    case ChangeWindow::YearToDate: {
+      int year, month, day;
+      civilFromDays(latestDay, year, month, day);
+      return daysFromCivil(year, 1, 1) - 1;
+    }
+    case ChangeWindow::Year:
+      return latestDay - 365;
+  }
+  return latestDay;
+}
+
+int computeChanges(const ChangeWindow* windows, int count, WindowChange* results) {
+  count = min(count, CHANGE_WINDOWS_MAX);
+  for (int i = 0; i < count; i++) {
+    results[i] = { windows[i], false, 0, 0.0f, 0 };
+  }
+
+  DailyNetWorth latest;
+  int32_t latestDay;
+  if (!getLatestNetWorth(latest) || !parseDayNumber(latest.date, latestDay)) {
+    return 0;
+  }
+
+  int32_t starts[CHANGE_WINDOWS_MAX];
+  int32_t baseDays[CHANGE_WINDOWS_MAX];
+  int32_t baseValues[CHANGE_WINDOWS_MAX];
+  bool found[CHANGE_WINDOWS_MAX];
+  int32_t earliest = latestDay;
+  for (int i = 0; i < count; i++) {
+    starts[i] = windowStart(windows[i], latestDay);
+    earliest = min(earliest, starts[i]);
+    found[i] = false;
+  }
+
+  /*
+    one forward pass from the record on or before the earliest start, every window keeps the last
+    record at or before its own start (the first record read stands in when history is shorter)
+  */
+  HistoryCursor cursor(max(0, findNetWorthIndex(earliest + 1) - 1), getRecordCount());
+  while (const DailyNetWorth* record = cursor.next()) {
+    int32_t day = cursor.day();
+    if (day == INT32_MIN) {
+      continue;
+    }
+
+    for (int i = 0; i < count; i++) {
+      if (!found[i] || day <= starts[i]) {
+        baseDays[i] = day;
+        baseValues[i] = record->netWorth;
+        found[i] = true;
+      }
+    }
+  }
+
+  int valid = 0;
+  for (int i = 0; i < count; i++) {
+    WindowChange& result = results[i];
+    if (!found[i] || baseDays[i] >= latestDay) {
+      continue;
+    }
+    result.valid = true;
+    result.change = latest.netWorth - baseValues[i];
+    result.percent = baseValues[i] != 0 ? (float)result.change / (float)baseValues[i] * 100.0f : 0.0f;
+    result.spanDays = latestDay - baseDays[i];
+    valid++;
+  }
+  return valid;
+}
+
+const char* getChangeWindowLabel(ChangeWindow window) {
+  switch (window) {
+    case ChangeWindow::Day:
+      return "24H";
+    case ChangeWindow::Week:
+      return "7D";
+    case ChangeWindow::Month:
+      return "30D";
+    case ChangeWindow::YearToDate:
+      return "YTD";
+    case ChangeWindow::Year:
+      return "1Y";
+  }
+  return "";
+}
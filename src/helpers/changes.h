@@ -0,0 +1,33 @@
+#ifndef HELPERS_CHANGES_H
+#define HELPERS_CHANGES_H
+
+#include <Arduino.h>
+
+#define CHANGE_WINDOWS_MAX 8
+
+// lookback windows for the change panel
+enum class ChangeWindow : uint8_t {
+  Day,
+  Week,
+  Month, // 30 days
+  YearToDate, // since the last record of the previous year
+  Year // 365 days
+};
+
+struct WindowChange {
+  ChangeWindow window;
+  bool valid; // false until there are two days to compare
+  int32_t change; // dollars since the baseline
+  float percent; // e.g. 5.25 for +5.25%, 0 if the baseline is 0
+  int32_t spanDays; // days between the baseline and the latest record, shorter than the window if history is
+};
+
+// compute every window against the latest record (the staged one included) in a single pass over the tail
+// each baseline is the last record on or before the window's start, or the oldest record if history is shorter
+// up to CHANGE_WINDOWS_MAX windows, returns the number of valid results
+int computeChanges(const ChangeWindow* windows, int count, WindowChange* results);
+
+// short label for the panel ("24H", "7D", "30D", "YTD", "1Y")
+const char* getChangeWindowLabel(ChangeWindow window);
+
+#endif
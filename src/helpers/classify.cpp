@@ -0,0 +1,79 @@
+#include "classify.h"
+
+// indexed by AccountType
+static const char* const typeNames[] = {
+  "cash",
+  "credit",
+  "investment",
+  "real estate",
+  "loan",
+  "vehicle",
+  "cryptocurrency",
+  "employee compensation",
+  "other liability",
+  "other asset",
+  "depository",
+  "brokerage",
+  "other",
+  "credit card",
+  "mortgage",
+  "student",
+  "auto",
+  "line of credit",
+  "unknown"
+};
+
+static_assert(sizeof(typeNames) / sizeof(typeNames[0]) == (size_t)AccountType::Unknown + 1, "typeNames must match AccountType");
+
+AccountType classifyAccountType(const char* name) {
+  if (!name) {
+    return AccountType::Unknown;
+  }
+
+  // one hash pass and one compare, instead of a strcmp per candidate
+  AccountType type;
+  switch (accountTypeHash(name)) {
+    case accountTypeHash("cash"): type = AccountType::Cash; break;
+    case accountTypeHash("credit"): type = AccountType::Credit; break;
+    case accountTypeHash("investment"): type = AccountType::Investment; break;
+    case accountTypeHash("real estate"): type = AccountType::RealEstate; break;
+    case accountTypeHash("loan"): type = AccountType::Loan; break;
+    case accountTypeHash("vehicle"): type = AccountType::Vehicle; break;
+    case accountTypeHash("cryptocurrency"): type = AccountType::Cryptocurrency; break;
+    case accountTypeHash("employee compensation"): type = AccountType::EmployeeCompensation; break;
+    case accountTypeHash("other liability"): type = AccountType::OtherLiability; break;
+    case accountTypeHash("other asset"): type = AccountType::OtherAsset; break;
+    case accountTypeHash("depository"): type = AccountType::Depository; break;
+    case accountTypeHash("brokerage"): type = AccountType::Brokerage; break;
+    case accountTypeHash("other"): type = AccountType::Other; break;
+    case accountTypeHash("credit card"): type = AccountType::CreditCard; break;
+    case accountTypeHash("mortgage"): type = AccountType::Mortgage; break;
+    case accountTypeHash("student"): type = AccountType::Student; break;
+    case accountTypeHash("auto"): type = AccountType::Auto; break;
+    case accountTypeHash("line of credit"): type = AccountType::LineOfCredit; break;
+    default: return AccountType::Unknown;
+  }
+
+  // an unknown string can still land on a known hash
+  return strcmp(name, typeNames[(int)type]) == 0 ? type : AccountType::Unknown;
+}
+
+bool isLiabilityType(AccountType type) {
+  switch (type) {
+    case AccountType::Credit:
+    case AccountType::Loan:
+    case AccountType::OtherLiability:
+    case AccountType::CreditCard:
+    case AccountType::Mortgage:
+    case AccountType::Student:
+    case AccountType::Auto:
+    case AccountType::LineOfCredit:
+      return true;
+    default:
+      return false;
+  }
+}
+
+const char* getAccountTypeName(AccountType type) {
+  return typeNames[(int)type];
+}
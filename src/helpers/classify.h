@@ -0,0 +1,44 @@
+#ifndef HELPERS_CLASSIFY_H
+#define HELPERS_CLASSIFY_H
+
+#include <Arduino.h>
+
+// Lunch Money manual asset type_name values, plaid types and the subtypes that imply a direction
+enum class AccountType : uint8_t {
+  Cash,
+  Credit,
+  Investment,
+  RealEstate,
+  Loan,
+  Vehicle,
+  Cryptocurrency,
+  EmployeeCompensation,
+  OtherLiability,
+  OtherAsset,
+  Depository,
+  Brokerage,
+  Other,
+  CreditCard, // subtypes from here on
+  Mortgage,
+  Student,
+  Auto,
+  LineOfCredit,
+  Unknown
+};
+
+// FNV-1a, evaluated at compile time for the case labels in classifyAccountType()
+// the switch refuses to compile if two known names ever collide
+constexpr uint32_t accountTypeHash(const char* str, uint32_t hash = 2166136261u) {
+  return *str ? accountTypeHash(str + 1, (hash ^ (uint8_t)*str) * 16777619u) : hash;
+}
+
+// map a type, type_name or subtype string to its enum (Unknown for null or unrecognised strings)
+AccountType classifyAccountType(const char* name);
+
+// true for types whose balance is owed rather than owned
+bool isLiabilityType(AccountType type);
+
+// the Lunch Money string for a type, e.g. "other liability"
+const char* getAccountTypeName(AccountType type);
+
+#endif
@@ -1,150 +1,654 @@
 #include "database.h"
 #include "configuration.h"
 #include "format.h"
+#include "log.h"
+#include "calendar.h"
+#include "rollup.h"
+#include "dbmeta.h"
+#include "segment.h"
+#include <esp_rom_crc.h>
 #include <math.h>
 
+// layout of records written before they carried a crc
+struct LegacyNetWorth {
+  char date[DATE_LEN];
+  int32_t netWorth;
+};
+
+static uint32_t recordCrc(const DailyNetWorth& record) {
+  return esp_rom_crc32_le(0, (const uint8_t*)&record, offsetof(DailyNetWorth, crc));
+}
+
+bool isRecordValid(const DailyNetWorth& record) {
+  return record.crc == recordCrc(record);
+}
+
+// build a record with zeroed padding so the crc is reproducible
+static void makeRecord(DailyNetWorth& record, const char* date, int32_t netWorth) {
+  memset(&record, 0, sizeof(DailyNetWorth));
+  strncpy(record.date, date, DATE_LEN - 1);
+  record.netWorth = netWorth;
+  record.crc = recordCrc(record);
+}
+
+static uint32_t journalCrc(const DbJournal& journal) {
+  return esp_rom_crc32_le(0, (const uint8_t*)&journal, offsetof(DbJournal, crc));
+}
+
+// a file whose first record fails its crc but reads as the old 16 byte layout predates crcs
+static bool isLegacyFile() {
+  File file = LittleFS.open(DB_FILE, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  size_t size = file.size();
+  DailyNetWorth record;
+  bool current = size >= sizeof(DailyNetWorth) && file.read((uint8_t*)&record, sizeof(DailyNetWorth)) == sizeof(DailyNetWorth) && isRecordValid(record);
+
+  LegacyNetWorth legacy;
+  file.seek(0);
+  int32_t dayNumber;
+  bool legacyLayout = size > 0 && size % sizeof(LegacyNetWorth) == 0 && file.read((uint8_t*)&legacy, sizeof(LegacyNetWorth)) == sizeof(LegacyNetWorth) && parseDayNumber(legacy.date, dayNumber);
+  file.close();
+
+  return !current && legacyLayout;
+}
+
+// split the single file from before segments into per-year segments, adding crcs if it predates them
+// records that fail their crc or are out of date order can't be placed in a segment and are dropped
+static bool migrateSingleFile() {
+  bool legacy = isLegacyFile();
+  File source = LittleFS.open(DB_FILE, FILE_READ);
+  if (!source) {
+    LOG_ERROR("db", "Failed to open database for conversion");
+    return false;
+  }
+
+  int32_t lastDay = INT32_MIN;
+  int converted = rewriteSegments([&](DailyNetWorth* chunk, int maxRecords) {
+    int kept = 0;
+    while (kept < maxRecords) {
+      DailyNetWorth record;
+      if (legacy) {
+        LegacyNetWorth old;
+        if (source.read((uint8_t*)&old, sizeof(LegacyNetWorth)) != sizeof(LegacyNetWorth)) {
+          break;
+        }
+        old.date[DATE_LEN - 1] = '\0';
+        makeRecord(record, old.date, old.netWorth);
+      } else if (source.read((uint8_t*)&record, sizeof(DailyNetWorth)) != sizeof(DailyNetWorth)) {
+        break;
+      }
+
+      int32_t day;
+      if (isRecordValid(record) && parseDayNumber(record.date, day) && day > lastDay) {
+        lastDay = day;
+        chunk[kept++] = record;
+      }
+    }
+    return kept;
+  });
+  source.close();
+
+  if (converted < 0) {
+    LOG_ERROR("db", "Failed to convert database");
+    return false;
+  }
+
+  LittleFS.remove(DB_FILE);
+  LOG_INFO("db", "Split %d records into %d yearly segments", converted, getSegmentCount());
+  return true;
+}
+
+// finish (or discard) an in-place update that was interrupted, returns true if records changed
+static bool replayJournal() {
+  if (!LittleFS.exists(DB_JOURNAL_FILE)) {
+    return false;
+  }
+
+  DbJournal journal;
+  File file = LittleFS.open(DB_JOURNAL_FILE, FILE_READ);
+  bool valid = file && file.read((uint8_t*)&journal, sizeof(DbJournal)) == sizeof(DbJournal);
+  if (file) {
+    file.close();
+  }
+  valid = valid && journal.magic == DB_JOURNAL_MAGIC && journal.crc == journalCrc(journal) && isRecordValid(journal.record);
+
+  // the index must still hold the same day, a rewrite since the journal was written would have moved it
+  DailyNetWorth current;
+  valid = valid && readSegmentRecords(journal.index, &current, 1) == 1 && strncmp(current.date, journal.record.date, DATE_LEN - 1) == 0;
+
+  // a torn journal means the record itself was never touched
+  bool replayed = valid && writeSegmentRecord(journal.index, journal.record);
+  if (valid && !replayed) {
+    LOG_ERROR("db", "Failed to replay journal");
+    return false;
+  }
+
+  LittleFS.remove(DB_JOURNAL_FILE);
+  if (replayed) {
+    LOG_WARN("db", "Replayed interrupted update of record %d", (int)journal.index);
+  }
+  return replayed;
+}
+
+// cut corrupt records off the end of the current segment, reading only the tail, returns true if records were dropped
+static bool recoverTail() {
+  int stored = getSegmentRecordCount();
+  int validCount = stored;
+
+  // appends only ever tear the last record, but keep dropping until one checks out
+  DailyNetWorth record;
+  while (validCount > 0 && !(readSegmentRecords(validCount - 1, &record, 1) == 1 && isRecordValid(record))) {
+    validCount--;
+  }
+
+  if (validCount == stored) {
+    return false;
+  }
+
+  if (!truncateSegments(validCount)) {
+    LOG_ERROR("db", "Failed to truncate torn records");
+    return false;
+  }
+
+  LOG_WARN("db", "Dropped %d torn records", stored - validCount);
+  return true;
+}
+
 bool initDatabase() {
   if (!LittleFS.begin()) {
-      Serial.println("LittleFS mount failed!");
+      LOG_ERROR("db", "LittleFS mount failed!");
       return false;
   }
-  Serial.println("LittleFS mounted successfully");
-  Serial.printf("Total: %u bytes, Used: %u bytes\n", LittleFS.totalBytes(), LittleFS.usedBytes());
+  LOG_DEBUG("db", "LittleFS mounted, total: %u bytes, used: %u bytes", (unsigned)LittleFS.totalBytes(), (unsigned)LittleFS.usedBytes());
+
+  if (!initSegments()) {
+    LOG_ERROR("db", "Failed to load segment directory");
+    return false;
+  }
+
+  bool changed = LittleFS.exists(DB_FILE) && migrateSingleFile();
+  changed = replayJournal() || changed;
+  changed = recoverTail() || changed;
+
+  // the header and rollups are derived from the records, rebuild them if recovery changed any
+  if (changed) {
+    rebuildDbMeta();
+    rebuildRollups();
+    return true;
+  }
+
+  initDbMeta();
+
+  // rollups are derived data, recreate them if they were never built (or were deleted)
+  if (getSegmentRecordCount() > 0 && (!LittleFS.exists(ROLLUP_WEEK_FILE) || !LittleFS.exists(ROLLUP_MONTH_FILE))) {
+    rebuildRollups();
+  }
   return true;
 }
 
+/*
+  today's value is staged in RTC memory and only written to flash once the date rolls over
+  (or the battery is critical), the staged record either replaces stagedIndex or follows the
+  last stored record, every read below overlays it on the file
+*/
+RTC_DATA_ATTR static DailyNetWorth stagedRecord;
+RTC_DATA_ATTR static bool hasStaged = false;
+RTC_DATA_ATTR static int32_t stagedIndex = -1; // stored record the staged one replaces, -1 if it is new
+
+// records on flash, ignoring the staged one
+static int storedCount() {
+  return getSegmentRecordCount();
+}
+
+static bool stagedAppends() {
+  return hasStaged && stagedIndex < 0;
+}
+
+// read one record with the staged one overlaid
+static bool readRecord(int index, DailyNetWorth& result) {
+  int stored = storedCount();
+  if (hasStaged && (index == stagedIndex || (stagedIndex < 0 && index == stored))) {
+    result = stagedRecord;
+    return true;
+  }
+
+  return index < stored && readSegmentRecords(index, &result, 1) == 1;
+}
+
 int getRecordCount() {
-  File file = LittleFS.open(DB_FILE, FILE_READ);
-  if (!file) {
-    return 0;
+  return storedCount() + (stagedAppends() ? 1 : 0);
+}
+
+int getStoredRecordCount() {
+  return storedCount();
+}
+
+bool HistoryCursor::refill() {
+  index += filled;
+  position = 0;
+  filled = 0;
+  if (index >= end) {
+    return false;
   }
 
-  int count = file.size() / sizeof(DailyNetWorth);
-  file.close();
-  return count;
+  // a new staged record sits right after the stored ones
+  int stored = storedCount();
+  if (index < stored) {
+    filled = readSegmentRecords(index, buffer, min(DB_READ_CHUNK, min(end, stored) - index));
+  } else if (overlay && stagedAppends() && index == stored) {
+    buffer[0] = stagedRecord;
+    filled = 1;
+  }
+
+  if (filled <= 0) {
+    end = index;
+    return false;
+  }
+  return true;
 }
 
-// find index of record with matching date, returns -1 if not found
-static int findDateIndex(const char* date) {
-  File file = LittleFS.open(DB_FILE, FILE_READ);
-  if (!file) {
-    return -1;
+const DailyNetWorth* HistoryCursor::next() {
+  while (position < filled || refill()) {
+    int at = index + position;
+    DailyNetWorth& record = buffer[position++];
+
+    if (overlay && hasStaged && at == stagedIndex) {
+      record = stagedRecord;
+    } else if (!isRecordValid(record)) {
+      LOG_WARN("db", "Skipping corrupt record %d", at);
+      continue;
+    }
+
+    dayParsed = false;
+    return &record;
   }
-  DailyNetWorth record;
-  int index = 0;
+  return nullptr;
+}
+
+int32_t HistoryCursor::day() {
+  if (!dayParsed && position > 0 && !parseDayNumber(buffer[position - 1].date, currentDay)) {
+    currentDay = INT32_MIN;
+  }
+  dayParsed = true;
+  return currentDay;
+}
 
-  while (file.read((uint8_t*)&record, sizeof(DailyNetWorth)) == sizeof(DailyNetWorth)) {
-    if (strncmp(record.date, date, DATE_LEN - 1) == 0) {
-      file.close();
+// day of the first valid record in [index, end), returns its index or end if there is none
+static int probeDay(int index, int end, int32_t& dayNumber) {
+  DailyNetWorth record;
+  for (; index < end; index++) {
+    if (readSegmentRecords(index, &record, 1) == 1 && isRecordValid(record) && parseDayNumber(record.date, dayNumber)) {
       return index;
     }
-    index++;
   }
-  file.close();
-  return -1;
+  return end;
 }
 
-bool saveNetWorth(const char* date, int32_t netWorth) {
-  DailyNetWorth entry;
-  strncpy(entry.date, date, DATE_LEN - 1);
-  entry.date[DATE_LEN - 1] = '\0';
-  entry.netWorth = netWorth;
+// first stored record dated on or after dayNumber (storedCount() if none)
+// a binary search over the segment directory, then over the records of the one segment that covers it
+static int lowerBoundStored(int32_t dayNumber) {
+  int segment = findSegmentByDay(dayNumber);
+  if (segment == getSegmentCount()) {
+    return storedCount();
+  }
+
+  const DbSegment& range = getSegment(segment);
+  int low = range.firstIndex;
+  int high = range.firstIndex + range.count;
+  while (low < high) {
+    int32_t day;
+    int mid = low + (high - low) / 2;
+
+    // corrupt records can't be compared, the probe moves on to the next readable one
+    int probed = probeDay(mid, high, day);
+    if (probed < high && day < dayNumber) {
+      low = probed + 1;
+    } else {
+      high = probed < high ? probed : mid;
+    }
+  }
+  return low;
+}
+
+int findNetWorthIndex(int32_t dayNumber) {
+  int index = lowerBoundStored(dayNumber);
+
+  // the staged record replaces one inside the stored range, or is the next day after it
+  if (index == storedCount() && stagedAppends()) {
+    int32_t stagedDay;
+    if (!parseDayNumber(stagedRecord.date, stagedDay) || stagedDay < dayNumber) {
+      index++;
+    }
+  }
+  return index;
+}
+
+// find index of record with matching date (copying it into existing if given), returns -1 if not found
+static int findDateIndex(const char* date, DailyNetWorth* existing = nullptr) {
+  int32_t dayNumber;
+  if (!parseDayNumber(date, dayNumber)) {
+    return -1;
+  }
 
-  int existingIndex = findDateIndex(date);
+  int index = lowerBoundStored(dayNumber);
+  DailyNetWorth record;
+  if (index >= storedCount() || readSegmentRecords(index, &record, 1) != 1 || strncmp(record.date, date, DATE_LEN - 1) != 0) {
+    return -1;
+  }
+
+  if (existing) {
+    *existing = record;
+  }
+  return index;
+}
+
+static bool insertRecord(const DailyNetWorth& entry, int32_t dayNumber);
+
+// day of the newest stored record, INT32_MIN if there is none
+static int32_t lastStoredDay() {
+  return storedCount() > 0 ? getSegment(getSegmentCount() - 1).lastDay : INT32_MIN;
+}
+
+// write a record to flash, replacing the stored record with the same date, and fold it into the derived data
+static bool writeRecord(const DailyNetWorth& entry) {
+  const char* date = entry.date;
+  int32_t netWorth = entry.netWorth;
+
+  int32_t dayNumber;
+  bool dated = parseDayNumber(date, dayNumber);
+
+  DailyNetWorth previous = {}; // findDateIndex only fills it when the date is stored
+  int existingIndex = findDateIndex(date, &previous);
 
   if (existingIndex >= 0) {
-    File file = LittleFS.open(DB_FILE, "r+");
-    if (!file) {
-      Serial.println("Failed to open database for update");
+    // journal the new record first, a brown-out mid-write is finished at the next mount
+    DbJournal journal;
+    memset(&journal, 0, sizeof(DbJournal));
+    journal.magic = DB_JOURNAL_MAGIC;
+    journal.index = existingIndex;
+    journal.record = entry;
+    journal.crc = journalCrc(journal);
+
+    File file = LittleFS.open(DB_JOURNAL_FILE, FILE_WRITE);
+    if (!file || file.write((uint8_t*)&journal, sizeof(DbJournal)) != sizeof(DbJournal)) {
+      if (file) {
+        file.close();
+      }
+      LittleFS.remove(DB_JOURNAL_FILE);
+      LOG_ERROR("db", "Failed to write journal");
       return false;
     }
-
-    file.seek(existingIndex * sizeof(DailyNetWorth));
-    size_t written = file.write((uint8_t*)&entry, sizeof(DailyNetWorth));
     file.close();
 
-    if (written != sizeof(DailyNetWorth)) {
-      Serial.println("Failed to update record");
+    // leave the journal in place on failure so the update is retried at mount
+    if (!writeSegmentRecord(existingIndex, entry)) {
+      LOG_ERROR("db", "Failed to update record");
       return false;
     }
+    LittleFS.remove(DB_JOURNAL_FILE);
 
-    Serial.printf("Updated net worth for %s: $%d\n", date, netWorth);
+    LOG_INFO("db", "Updated net worth for %s: $%d", date, netWorth);
+  } else if (dated && dayNumber <= lastStoredDay()) {
+    // older than the newest record (the clock stepped back), it goes in date order so the binary searches hold
+    return insertRecord(entry, dayNumber);
   } else {
-    File file = LittleFS.open(DB_FILE, FILE_APPEND);
-    if (!file) {
-      Serial.println("Failed to open database for append");
+    // segments are per year, an undatable record has nowhere to go
+    if (!dated || !appendSegmentRecord(entry, dayNumber)) {
+      LOG_ERROR("db", "Failed to append record");
       return false;
     }
 
-    size_t written = file.write((uint8_t*)&entry, sizeof(DailyNetWorth));
-    file.close();
+    LOG_INFO("db", "Saved net worth for %s: $%d", date, netWorth);
+  }
 
-    if (written != sizeof(DailyNetWorth)) {
-      Serial.println("Failed to append record");
-      return false;
-    }
+  if (dated) {
+    updateRollups(dayNumber, netWorth, existingIndex >= 0);
+    updateDbMeta(dayNumber, netWorth, existingIndex >= 0, previous.netWorth);
+  }
 
-    Serial.printf("Saved net worth for %s: $%d\n", date, netWorth);
+  return true;
+}
+
+bool commitNetWorth() {
+  if (!hasStaged) {
+    return true;
   }
 
+  // clear the overlay first so the rollups recompute from what is actually on flash
+  DailyNetWorth entry = stagedRecord;
+  hasStaged = false;
+
+  // an undatable record can never be written, keeping it would block every later save
+  int32_t dayNumber;
+  if (!parseDayNumber(entry.date, dayNumber)) {
+    LOG_WARN("db", "Dropping undated staged record %s", entry.date);
+    return true;
+  }
+
+  if (!writeRecord(entry)) {
+    hasStaged = true;
+    return false;
+  }
   return true;
 }
 
-bool getLatestNetWorth(DailyNetWorth& result) {
-  File file = LittleFS.open(DB_FILE, FILE_READ);
-  if (!file || file.size() < sizeof(DailyNetWorth)) {
-    if (file) {
-      file.close();
-    }
+bool saveNetWorth(const char* date, int32_t netWorth) {
+  // "00-00-0000" from a clock that never synced
+  int32_t dayNumber;
+  if (!parseDayNumber(date, dayNumber)) {
+    LOG_ERROR("db", "Refusing to stage undated net worth %s", date);
     return false;
   }
 
-  file.seek(file.size() - sizeof(DailyNetWorth));
-  size_t bytesRead = file.read((uint8_t*)&result, sizeof(DailyNetWorth));
-  file.close();
+  if (hasStaged && strncmp(stagedRecord.date, date, DATE_LEN - 1) == 0) {
+    makeRecord(stagedRecord, date, netWorth);
+    LOG_INFO("db", "Staged net worth for %s: $%d", date, netWorth);
+    return true;
+  }
+
+  // a new day, the previous one is final
+  if (!commitNetWorth()) {
+    return false;
+  }
+
+  // the staged record can only follow the stored ones, an older new day is written in place right away
+  stagedIndex = findDateIndex(date);
+  if (stagedIndex < 0 && dayNumber <= lastStoredDay()) {
+    DailyNetWorth entry;
+    makeRecord(entry, date, netWorth);
+    return writeRecord(entry);
+  }
 
-  return bytesRead == sizeof(DailyNetWorth);
+  makeRecord(stagedRecord, date, netWorth);
+  hasStaged = true;
+  LOG_INFO("db", "Staged net worth for %s: $%d", date, netWorth);
+  return true;
 }
 
-bool getNetWorthDaysAgo(int daysAgo, DailyNetWorth& result) {
+bool getLatestNetWorth(DailyNetWorth& result) {
   int recordCount = getRecordCount();
-  if (recordCount == 0) {
+  return recordCount > 0 && readRecord(recordCount - 1, result);
+}
+
+bool getNetWorthOnOrBefore(int32_t dayNumber, DailyNetWorth& result) {
+  // corrupt records are stepped over towards older ones
+  for (int index = findNetWorthIndex(dayNumber + 1) - 1; index >= 0; index--) {
+    if (readRecord(index, result) && isRecordValid(result)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool getNetWorthDaysAgo(int daysAgo, DailyNetWorth& result) {
+  DailyNetWorth latest;
+  int32_t latestDay;
+  if (!getLatestNetWorth(latest) || !parseDayNumber(latest.date, latestDay)) {
     return false;
   }
 
   // clamp to oldest available if not enough history
-  int targetIndex = max(0, recordCount - 1 - daysAgo);
+  return getNetWorthOnOrBefore(latestDay - daysAgo, result) || readRecord(0, result);
+}
 
-  File file = LittleFS.open(DB_FILE, FILE_READ);
-  if (!file) {
+int getMissingDays(int32_t fromDay, int32_t toDay) {
+  if (toDay < fromDay) {
+    return 0;
+  }
+  int recorded = findNetWorthIndex(toDay + 1) - findNetWorthIndex(fromDay);
+  return max(0, (toDay - fromDay + 1) - recorded);
+}
+
+// pull stored records for rewriteSegments from next on, dropping ones that fail their crc, can't be dated or are out of order
+static int readOrdered(int& next, int32_t& lastDay, DailyNetWorth* chunk, int maxRecords) {
+  int stored = storedCount();
+  int kept = 0;
+  while (kept == 0 && next < stored) {
+    int got = readSegmentRecords(next, chunk, min(maxRecords, stored - next));
+    if (got <= 0) {
+      break;
+    }
+    next += got;
+
+    for (int i = 0; i < got; i++) {
+      int32_t day;
+      if (isRecordValid(chunk[i]) && parseDayNumber(chunk[i].date, day) && day > lastDay) {
+        lastDay = day;
+        chunk[kept++] = chunk[i];
+      }
+    }
+  }
+  return kept;
+}
+
+// rewrite the segments with one new record placed by date, the header and rollups are rebuilt afterwards
+static bool insertRecord(const DailyNetWorth& entry, int32_t dayNumber) {
+  int next = 0;
+  int32_t lastDay = INT32_MIN;
+  bool inserted = false;
+  int written = rewriteSegments([&](DailyNetWorth* chunk, int maxRecords) {
+    // one slot is left free for the new record
+    int got = readOrdered(next, lastDay, chunk, maxRecords - 1);
+    if (inserted) {
+      return got;
+    }
+
+    int position = 0;
+    int32_t day;
+    while (position < got && parseDayNumber(chunk[position].date, day) && day < dayNumber) {
+      position++;
+    }
+    if (position == got && next < storedCount()) {
+      return got; // every record so far is older
+    }
+
+    memmove(chunk + position + 1, chunk + position, (got - position) * sizeof(DailyNetWorth));
+    chunk[position] = entry;
+    inserted = true;
+    lastDay = max(lastDay, dayNumber);
+    return got + 1;
+  });
+
+  if (written < 0) {
+    LOG_ERROR("db", "Failed to insert record");
     return false;
   }
 
-  file.seek(targetIndex * sizeof(DailyNetWorth));
-  size_t bytesRead = file.read((uint8_t*)&result, sizeof(DailyNetWorth));
-  file.close();
+  rebuildDbMeta();
+  rebuildRollups();
+  LOG_INFO("db", "Inserted net worth for %s: $%d", entry.date, entry.netWorth);
+  return true;
+}
+
+int prependNetWorthHistory(const std::function<int(DailyNetWorth* chunk, int maxRecords)>& source) {
+  DailyNetWorth first;
+  int stored = storedCount();
+  int32_t firstDay = INT32_MAX;
+  if (stored > 0 && readRecord(0, first)) {
+    parseDayNumber(first.date, firstDay);
+  } else if (stored == 0 && hasStaged) {
+    parseDayNumber(stagedRecord.date, firstDay);
+  }
+
+  // the imported records first, then the existing ones, each year written to its segment once
+  int32_t lastDay = INT32_MIN;
+  int added = 0;
+  int next = 0;
+  bool importing = true;
+  int written = rewriteSegments([&](DailyNetWorth* chunk, int maxRecords) {
+    while (importing) {
+      int got = source(chunk, maxRecords);
+      if (got <= 0) {
+        importing = false;
+        break;
+      }
+
+      int kept = 0;
+      for (int i = 0; i < got; i++) {
+        int32_t day;
+        if (!parseDayNumber(chunk[i].date, day) || day >= firstDay || day <= lastDay) {
+          continue;
+        }
+        lastDay = day;
+
+        // compacted in place, so copy out before rebuilding the record with its crc
+        DailyNetWorth record = chunk[i];
+        record.date[DATE_LEN - 1] = '\0';
+        makeRecord(chunk[kept++], record.date, record.netWorth);
+      }
+      added += kept;
+      if (kept > 0) {
+        return kept;
+      }
+    }
+    return readOrdered(next, lastDay, chunk, maxRecords);
+  });
+
+  if (written < 0) {
+    LOG_ERROR("db", "Failed to import history");
+    return -1;
+  }
 
-  return bytesRead == sizeof(DailyNetWorth);
+  // every stored index moved
+  if (hasStaged && stagedIndex >= 0) {
+    stagedIndex = findDateIndex(stagedRecord.date);
+  }
+
+  rebuildDbMeta();
+  rebuildRollups();
+  LOG_INFO("db", "Imported %d historical records", added);
+  return added;
 }
 
-int getNetWorthHistory(DailyNetWorth* buffer, int maxDays) {
-  File file = LittleFS.open(DB_FILE, FILE_READ);
-  if (!file) {
-    return 0;
+int compactDatabase() {
+  // indices are about to change, so the staged record goes to flash first
+  if (!commitNetWorth()) {
+    return -1;
   }
 
-  int totalRecords = file.size() / sizeof(DailyNetWorth);
-  int toRead = min(maxDays, totalRecords);
-  int startIndex = totalRecords - toRead;
+  int stored = storedCount();
+  int next = 0;
+  int32_t lastDay = INT32_MIN;
+  int kept = rewriteSegments([&](DailyNetWorth* chunk, int maxRecords) {
+    return readOrdered(next, lastDay, chunk, maxRecords);
+  });
 
-  file.seek(startIndex * sizeof(DailyNetWorth));
-  size_t bytesRead = file.read((uint8_t*)buffer, toRead * sizeof(DailyNetWorth));
-  file.close();
+  if (kept < 0) {
+    LOG_ERROR("db", "Failed to compact database");
+    return -1;
+  }
 
-  return bytesRead / sizeof(DailyNetWorth);
+  int dropped = stored - kept;
+  rebuildDbMeta();
+  rebuildRollups();
+  LOG_INFO("db", "Compacted database, dropped %d records", dropped);
+  return dropped;
 }
 
-float getPercentageChange(int daysAgo) {
+float getPercentageChange(int daysAgo, int* spanDays) {
   DailyNetWorth latest;
   if (!getLatestNetWorth(latest)) {
     return 0.0f;
@@ -155,6 +659,13 @@ float getPercentageChange(int daysAgo) {
     return 0.0f;
   }
 
+  // a missed day moves the baseline further back, the caller can label the actual span
+  int32_t latestDay;
+  int32_t pastDay;
+  if (spanDays && parseDayNumber(latest.date, latestDay) && parseDayNumber(past.date, pastDay)) {
+    *spanDays = latestDay - pastDay;
+  }
+
   if (past.netWorth == 0) {
     return 0.0f;
   }
@@ -163,116 +674,65 @@ float getPercentageChange(int daysAgo) {
   return change;
 }
 
-String getGoalProjection() {
-  int recordCount = getRecordCount();
+bool getGoalProjection(char* buffer, size_t size) {
+  const DbMeta& meta = getDbMeta();
 
   // need at least 14 days of data for a "meaningful" projection
-  if (recordCount < 14) {
-    return "";
-  }
-
-  DailyNetWorth currentNW;
-  if (!getLatestNetWorth(currentNW)) {
-    return "";
-  }
-
-  if (currentNW.netWorth >= GOAL) {
-    return "Goal Reached!";
-  }
-
-  DailyNetWorth startNW;
-  if (!getNetWorthDaysAgo(365, startNW)) {
-    return "";
+  if (meta.all.n < 14) {
+    return false;
   }
 
-  float delta = (float)(currentNW.netWorth - startNW.netWorth);
-
-  // scale up delta to annual velocity if we have less than a year of data
-  int daysOfData = min(recordCount, 365);
-  float annualVelocity = delta * (365.0f / (float)daysOfData);
-
-  // if recent velocity is negative but we have more history, try all-time average
-  if (annualVelocity <= 0 && recordCount > 365) {
-    DailyNetWorth oldestNW;
-    if (getNetWorthDaysAgo(recordCount - 1, oldestNW)) {
-      float allTimeDelta = (float)(currentNW.netWorth - oldestNW.netWorth);
-      annualVelocity = allTimeDelta * (365.0f / (float)recordCount);
-    }
+  // the header only covers committed days, today's staged value may be newer
+  DailyNetWorth latest;
+  int32_t current = getLatestNetWorth(latest) ? latest.netWorth : meta.lastValue;
+  if (current >= GOAL) {
+    snprintf(buffer, size, "Goal Reached!");
+    return true;
   }
 
-  String goalStr = formatCurrency(GOAL);
+  /*
+    least-squares trend from the running sums in the database header (no record reads),
+    weighted towards recent history so the projection follows changes in savings rate
+  */
+  float slope = 0.0f;
+  bool hasTrend = getTrendSlope(PROJECTION_HALF_LIFE_DAYS > 0, slope);
 
-  if (annualVelocity <= 0) {
-    return "";
+  // if the recent trend is negative, fall back to the whole history
+  if (!hasTrend || slope <= 0) {
+    hasTrend = getTrendSlope(false, slope);
   }
 
-  float gap = (float)(GOAL - currentNW.netWorth);
-  float years;
-
-  /*
-    calculate growth rate of velocity based on available data
-    this accounts for accelerating wealth accumulation over time
-  */
-  float growthRate = 0.0f;
-  bool useGrowthProjection = false;
-
-  int termDays = 0;
-  if (recordCount >= 730) {
-    termDays = 365; // 2+ years: compare recent 12 months to prior 12 months
-  } else if (recordCount >= 365) {
-    termDays = 180; // 1-2 years: compare recent 6 months to prior 6 months
-  } else if (recordCount >= 180) {
-    termDays = 90; // 6-12 months: compare recent 3 months to prior 3 months
-  }
-
-  if (termDays > 0) {
-    DailyNetWorth firstTermNW, secondTermNW;
-    if (getNetWorthDaysAgo(termDays, firstTermNW) && getNetWorthDaysAgo(termDays * 2, secondTermNW)) {
-      float recentDelta = (float)(currentNW.netWorth - firstTermNW.netWorth);
-      float priorDelta = (float)(firstTermNW.netWorth - secondTermNW.netWorth);
-      if (priorDelta > 0 && recentDelta > 0) {
-        growthRate = (recentDelta - priorDelta) / priorDelta;
-        useGrowthProjection = true;
-      }
-    }
+  float annualVelocity = slope * 365.0f;
+  if (!hasTrend || annualVelocity <= 0) {
+    return false;
   }
 
-  if (useGrowthProjection && growthRate > 0.01f && growthRate < 2.0f) {
-    /*
-      use geometric series formula to account for accelerating growth
-      sum after n years = V * ((1 + g)^n - 1) / g
-      solving for n: n = log(1 + gap * g / V) / log(1 + g)
-    */
+  float gap = (float)(GOAL - current);
+  float years = gap / annualVelocity;
 
-    float term = 1.0f + (gap * growthRate) / annualVelocity;
-    if (term > 0) {
-      years = log(term) / log(1.0f + growthRate);
-    } else {
-      years = gap / annualVelocity; // fallback to linear if negative growth rate
-    }
-  } else {
-    // < 6 months: use linear projection (constant velocity)
-    years = gap / annualVelocity;
-  }
+  char goalStr[CURRENCY_LEN];
+  formatCurrency(goalStr, sizeof(goalStr), GOAL);
 
   float totalMonths = years * 12.0f;
 
   if (totalMonths < 1.0f) {
-    return "Less than a month to " + goalStr;
+    snprintf(buffer, size, "Less than a month to %s", goalStr);
+    return true;
   }
 
   if (years < 1.0f) {
     int m = (int)floor(totalMonths);
     if (m < 1) m = 1;
-    return String(m) + (m == 1 ? " month to " : " months to ") + goalStr;
+    snprintf(buffer, size, "%d %s to %s", m, m == 1 ? "month" : "months", goalStr);
+    return true;
   }
 
   float roundedYears = round(years * 10.0f) / 10.0f;
   if (roundedYears == (int)roundedYears) {
-    return String((int)roundedYears) + " year" + ((int)roundedYears == 1 ? "" : "s") + " to " + goalStr;
+    snprintf(buffer, size, "%d year%s to %s", (int)roundedYears, (int)roundedYears == 1 ? "" : "s", goalStr);
+    return true;
   }
 
-  char buffer[16];
-  snprintf(buffer, sizeof(buffer), "%.1f", roundedYears);
-  return String(buffer) + " years to " + goalStr;
+  snprintf(buffer, size, "%.1f years to %s", roundedYears, goalStr);
+  return true;
 }
\ No newline at end of file
@@ -3,28 +3,62 @@
 
 #include <Arduino.h>
 #include <LittleFS.h>
+#include <functional>
 
-#define DB_FILE "/networth.dat"
+#define DB_FILE "/networth.dat" // single file from before yearly segments (see segment.h), split on the first mount
+#define DB_JOURNAL_FILE "/networth.jnl" // pending in-place update, replayed at mount if a write was interrupted
+// LittleFS VFS base path, for the POSIX calls the File API lacks (the host tool points it at its working directory)
+#ifndef DB_MOUNT_POINT
+  #define DB_MOUNT_POINT "/littlefs"
+#endif
+#define DB_JOURNAL_MAGIC 0x4C4E4A4E // "NJNL"
 #define DATE_LEN 11 // "MM-DD-YYYY\0"
+#define DB_READ_CHUNK 32 // records read per file access when streaming history
 
 struct DailyNetWorth {
   char date[DATE_LEN]; // "MM-DD-YYYY"
   int32_t netWorth; // net worth in whole dollars (rounded)
+  uint32_t crc; // crc32 of the bytes above (padding zeroed), a mismatch marks a torn or corrupt record
+};
+
+// record written before an in-place update and removed once the update is on flash
+struct DbJournal {
+  uint32_t magic;
+  int32_t index; // record being overwritten
+  DailyNetWorth record;
+  uint32_t crc; // crc32 of the bytes above
 };
 
-// initialize LittleFS filesystem
+// initialize LittleFS filesystem, load the segment directory, replay an interrupted update and drop a torn tail record
+// a single file from before segments (or before records carried a crc) is converted on the first mount
 bool initDatabase();
 
+// check a record's crc
+bool isRecordValid(const DailyNetWorth& record);
+
 // save or update net worth for a specific date (format: "MM-DD-YYYY")
+// the value is staged in RTC memory and written to flash when a later date is saved (or on commitNetWorth)
+// all reads below see the staged value
 bool saveNetWorth(const char* date, int32_t netWorth);
 
-// get percentage change comparing latest value to value from X days ago
+// write the staged value to flash now, e.g. before the battery dies
+// also folds it into the weekly and monthly rollups (see rollup.h) and the database header (see dbmeta.h)
+bool commitNetWorth();
+
+// get percentage change comparing latest value to the value recorded X calendar days before it
+// (or the nearest earlier day if that one was missed), spanDays gets the actual days between the two
 // returns the percentage as a float (e.g., 5.25 for +5.25%) or 0.0 if not enough
-float getPercentageChange(int daysAgo);
+float getPercentageChange(int daysAgo, int* spanDays = nullptr);
 
-// get net worth history for last X days
-// fills buffer with DailyNetWorth entries, oldest first (may be less than maxDays if not enough data)
-int getNetWorthHistory(DailyNetWorth* buffer, int maxDays);
+// put history older than the first stored record in front of it, rewriting the segments once
+// source fills chunk with up to maxRecords records (oldest first, ascending dates) and returns 0 when done
+// records not older than the first stored one are dropped, the header and rollups are rebuilt afterwards
+// returns the number of records added
+int prependNetWorthHistory(const std::function<int(DailyNetWorth* chunk, int maxRecords)>& source);
+
+// rewrite the segments without records that fail their crc, can't be dated or are out of date order
+// the header and rollups are rebuilt afterwards, returns the number of records dropped or -1 on failure
+int compactDatabase();
 
 // get total number of records stored
 int getRecordCount();
@@ -32,10 +66,98 @@ int getRecordCount();
 // get the most recent net worth value
 bool getLatestNetWorth(DailyNetWorth& result);
 
-// get net worth from X days ago (or oldest available if not enough data)
+// get net worth from X calendar days before the latest record, the nearest earlier record if that day
+// was missed (or oldest available if not enough data)
 bool getNetWorthDaysAgo(int daysAgo, DailyNetWorth& result);
 
-// get the linear goal projection
-String getGoalProjection();
+// get the latest record dated on or before dayNumber, O(log n) in the number of records
+bool getNetWorthOnOrBefore(int32_t dayNumber, DailyNetWorth& result);
+
+// days in [fromDay, toDay] without a record, from two index lookups rather than a scan
+int getMissingDays(int32_t fromDay, int32_t toDay);
+
+// get the goal projection text (e.g. "8.4 years to $1,000,000") into buffer
+// returns false if there isn't enough history or progress to project
+bool getGoalProjection(char* buffer, size_t size);
+
+// index of the first record dated on or after dayNumber (getRecordCount() if there is none), a binary search
+int findNetWorthIndex(int32_t dayNumber);
+
+// records on flash, without a staged one
+int getStoredRecordCount();
+
+// sequential reader over records [first, end), DB_READ_CHUNK records per file access
+// records failing their crc are skipped, with overlay the staged record is swapped in where it replaces
+// one and follows the stored ones when it is new
+class HistoryCursor {
+ public:
+  HistoryCursor(int first, int end, bool overlay = true) : index(first), end(end), overlay(overlay) {}
+
+  // next record, nullptr once the range is done
+  const DailyNetWorth* next();
+
+  // day number of the record last returned by next() (INT32_MIN if it can't be dated), parsed on first use
+  int32_t day();
+
+  // index of the record last returned by next()
+  int recordIndex() const { return index + position - 1; }
+
+ private:
+  bool refill();
+
+  DailyNetWorth buffer[DB_READ_CHUNK];
+  int index; // record index of buffer[0]
+  int end;
+  int filled = 0;
+  int position = 0;
+  bool overlay;
+  int32_t currentDay = INT32_MIN;
+  bool dayParsed = false;
+};
+
+// call visit(record) for each record dated within [fromDay, toDay], oldest first, staged record included
+// the visitor is a template parameter so lambdas inline, returns the number of records visited
+template <typename Visitor>
+int forEachNetWorthBetween(int32_t fromDay, int32_t toDay, Visitor&& visit) {
+  HistoryCursor cursor(findNetWorthIndex(fromDay), getRecordCount());
+  int visited = 0;
+  while (const DailyNetWorth* record = cursor.next()) {
+    if (cursor.day() > toDay) {
+      break;
+    }
+    if (cursor.day() >= fromDay) {
+      visit(*record);
+      visited++;
+    }
+  }
+  return visited;
+}
+
+// call visit(record) for each of the last maxDays records, oldest first
+// records failing their crc are skipped, returns the number of records visited
+template <typename Visitor>
+int forEachRecentNetWorth(int maxDays, Visitor&& visit) {
+  int total = getRecordCount();
+  HistoryCursor cursor(total - min(maxDays, total), total);
+  int visited = 0;
+  while (const DailyNetWorth* record = cursor.next()) {
+    visit(*record);
+    visited++;
+  }
+  return visited;
+}
+
+// same as forEachRecentNetWorth but only the records on flash, for rebuilding data derived from them
+template <typename Visitor>
+int forEachStoredNetWorth(int maxDays, Visitor&& visit) {
+  int stored = getStoredRecordCount();
+  HistoryCursor cursor(stored - min(maxDays, stored), stored, false);
+  int visited = 0;
+  while (const DailyNetWorth* record = cursor.next()) {
+    visit(*record);
+    visited++;
+  }
+  return visited;
+}
 
 #endif
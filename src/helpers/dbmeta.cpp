@@ -0,0 +1,191 @@
+#include "dbmeta.h"
+#include "database.h"
+#include "calendar.h"
+#include "log.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <math.h>
+
+static DbMeta meta;
+
+static void resetMeta() {
+  memset(&meta, 0, sizeof(DbMeta));
+  meta.magic = DB_META_MAGIC;
+  meta.version = DB_META_VERSION;
+  meta.size = sizeof(DbMeta);
+}
+
+// weight multiplier for one day of age
+static double decayPerDay() {
+  return PROJECTION_HALF_LIFE_DAYS > 0 ? pow(0.5, 1.0 / PROJECTION_HALF_LIFE_DAYS) : 1.0;
+}
+
+// add (sign = 1) or remove (sign = -1) one daily point from every sum
+static void applyPoint(int32_t dayNumber, int32_t netWorth, int sign) {
+  if (meta.all.n == 0 && sign > 0) {
+    meta.originDay = dayNumber;
+    meta.recent.refDay = dayNumber;
+  }
+
+  int64_t t = dayNumber - meta.originDay;
+  int64_t v = netWorth;
+
+  RegressionSums& all = meta.all;
+  all.n += sign;
+  all.sumT += sign * t;
+  all.sumV += sign * v;
+  all.sumTT += sign * t * t;
+  all.sumTV += sign * t * v;
+
+  // a newer day ages every existing point before it is added with weight 1
+  DecayedSums& recent = meta.recent;
+  if (dayNumber > recent.refDay) {
+    double factor = pow(decayPerDay(), dayNumber - recent.refDay);
+    recent.w *= factor;
+    recent.sumT *= factor;
+    recent.sumV *= factor;
+    recent.sumTT *= factor;
+    recent.sumTV *= factor;
+    recent.refDay = dayNumber;
+  }
+
+  double weight = sign * pow(decayPerDay(), recent.refDay - dayNumber);
+  recent.w += weight;
+  recent.sumT += weight * t;
+  recent.sumV += weight * v;
+  recent.sumTT += weight * t * t;
+  recent.sumTV += weight * t * v;
+
+  if (sign > 0 && (all.n == 1 || dayNumber >= meta.lastDay)) {
+    meta.lastDay = dayNumber;
+    meta.lastValue = netWorth;
+  }
+}
+
+// fold a committed day into the risk statistics, keeping what they were before it
+static void applyRisk(int32_t dayNumber, int32_t netWorth) {
+  if (meta.risk.days > 0 && dayNumber == meta.risk.lastDay) {
+    meta.risk = meta.riskBeforeLast;
+  } else if (meta.risk.days > 0 && dayNumber < meta.risk.lastDay) {
+    return;
+  }
+
+  meta.riskBeforeLast = meta.risk;
+  addRiskPoint(meta.risk, dayNumber, netWorth);
+}
+
+// the risk statistics depend on record order, so an older day changing means starting over
+static void rebuildRisk() {
+  memset(&meta.risk, 0, sizeof(RiskStats));
+  memset(&meta.riskBeforeLast, 0, sizeof(RiskStats));
+
+  forEachStoredNetWorth(INT_MAX, [](const DailyNetWorth& record) {
+    int32_t dayNumber;
+    if (parseDayNumber(record.date, dayNumber)) {
+      applyRisk(dayNumber, record.netWorth);
+    }
+  });
+}
+
+static uint32_t metaCrc() {
+  return esp_rom_crc32_le(0, (const uint8_t*)&meta, offsetof(DbMeta, crc));
+}
+
+static bool saveMeta() {
+  meta.crc = metaCrc();
+  File file = LittleFS.open(DB_META_FILE, FILE_WRITE);
+  if (!file) {
+    LOG_ERROR("meta", "Failed to open database header");
+    return false;
+  }
+
+  size_t written = file.write((uint8_t*)&meta, sizeof(DbMeta));
+  file.close();
+
+  if (written != sizeof(DbMeta)) {
+    LOG_ERROR("meta", "Failed to write database header");
+    return false;
+  }
+  return true;
+}
+
+bool initDbMeta() {
+  if (LittleFS.exists(DB_META_FILE)) {
+    File file = LittleFS.open(DB_META_FILE, FILE_READ);
+    bool ok = file && file.read((uint8_t*)&meta, sizeof(DbMeta)) == sizeof(DbMeta);
+    if (file) {
+      file.close();
+    }
+
+    if (ok && meta.magic == DB_META_MAGIC && meta.version == DB_META_VERSION && meta.size == sizeof(DbMeta) && meta.crc == metaCrc()) {
+      return true;
+    }
+    LOG_WARN("meta", "Database header is stale, rebuilding");
+  }
+
+  return rebuildDbMeta();
+}
+
+const DbMeta& getDbMeta() {
+  return meta;
+}
+
+bool updateDbMeta(int32_t dayNumber, int32_t netWorth, bool replaced, int32_t previousValue) {
+  if (replaced) {
+    applyPoint(dayNumber, previousValue, -1);
+  }
+  applyPoint(dayNumber, netWorth, 1);
+
+  if (meta.risk.days > 0 && dayNumber < meta.risk.lastDay) {
+    LOG_DEBUG("meta", "Backdated change, rescanning risk statistics");
+    rebuildRisk();
+  } else {
+    applyRisk(dayNumber, netWorth);
+  }
+  return saveMeta();
+}
+
+bool rebuildDbMeta() {
+  resetMeta();
+
+  forEachStoredNetWorth(INT_MAX, [](const DailyNetWorth& record) {
+    int32_t dayNumber;
+    if (parseDayNumber(record.date, dayNumber)) {
+      applyPoint(dayNumber, record.netWorth, 1);
+      applyRisk(dayNumber, record.netWorth);
+    }
+  });
+
+  LOG_INFO("meta", "Rebuilt database header from %d records", (int)meta.all.n);
+  return saveMeta();
+}
+
+bool getTrendSlope(bool decayed, float& dollarsPerDay) {
+  if (meta.all.n < 2) {
+    return false;
+  }
+
+  double n, sumT, sumV, sumTT, sumTV;
+  if (decayed) {
+    n = meta.recent.w;
+    sumT = meta.recent.sumT;
+    sumV = meta.recent.sumV;
+    sumTT = meta.recent.sumTT;
+    sumTV = meta.recent.sumTV;
+  } else {
+    n = meta.all.n;
+    sumT = meta.all.sumT;
+    sumV = meta.all.sumV;
+    sumTT = meta.all.sumTT;
+    sumTV = meta.all.sumTV;
+  }
+
+  // slope = (n * Σtv - Σt * Σv) / (n * Σt² - (Σt)²)
+  double denominator = n * sumTT - sumT * sumT;
+  if (denominator <= 0) {
+    return false;
+  }
+
+  dollarsPerDay = (float)((n * sumTV - sumT * sumV) / denominator);
+  return true;
+}
@@ -0,0 +1,68 @@
+#ifndef HELPERS_DBMETA_H
+#define HELPERS_DBMETA_H
+
+#include <Arduino.h>
+#include "riskstats.h"
+
+#define DB_META_FILE "/networth.meta"
+#define DB_META_MAGIC 0x544D574E // "NWMT"
+#define DB_META_VERSION 3
+
+// half-life in days of the decayed trend window, 0 fits the whole history evenly
+#ifndef PROJECTION_HALF_LIFE_DAYS
+  #define PROJECTION_HALF_LIFE_DAYS 365
+#endif
+
+// exact least-squares sums over every daily record, t is days since originDay
+struct RegressionSums {
+  int64_t n;
+  int64_t sumT;
+  int64_t sumV;
+  int64_t sumTT;
+  int64_t sumTV;
+};
+
+// the same sums with every point weighted by 0.5^(age / PROJECTION_HALF_LIFE_DAYS)
+struct DecayedSums {
+  int32_t refDay; // day the weights are decayed to (weight 1)
+  double w;
+  double sumT;
+  double sumV;
+  double sumTT;
+  double sumTV;
+};
+
+// database header kept next to the record file, so record offsets stay plain multiples of the record size
+struct DbMeta {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size; // sizeof(DbMeta) when written, a mismatch means the layout changed and triggers a rebuild
+  int32_t originDay; // day number of the first record
+  int32_t lastDay; // day number of the latest record
+  int32_t lastValue;
+  RegressionSums all;
+  DecayedSums recent;
+  RiskStats risk;
+  RiskStats riskBeforeLast; // risk as it was before lastDay, so re-saving the latest day stays O(1)
+  uint32_t crc; // crc32 of the bytes above
+};
+
+// load the header, rebuilding it from the records if it is missing, stale or fails its crc
+bool initDbMeta();
+
+// current header (valid after initDbMeta)
+const DbMeta& getDbMeta();
+
+// fold an upserted daily value into the header and persist it
+// pass replaced = true with the previous value when an existing day was overwritten
+// the risk statistics can't take back a day older than the latest, such an edit rescans the records for them
+bool updateDbMeta(int32_t dayNumber, int32_t netWorth, bool replaced, int32_t previousValue);
+
+// recompute the header from a single pass over the records
+bool rebuildDbMeta();
+
+// least-squares trend in dollars per day, from the decayed window or the whole history
+// returns false if there are too few points or no spread in time
+bool getTrendSlope(bool decayed, float& dollarsPerDay);
+
+#endif
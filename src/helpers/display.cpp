@@ -81,22 +81,16 @@ void drawSparkLine(
   int16_t y,
   int16_t width,
   int16_t height,
-  int32_t* values,
-  int count
+  const SparklineReducer& data
 ) {
+  int count = data.count();
   if (count < 2) {
     return;
   }
 
-  // find min and max for scaling
-  int32_t minVal = values[0];
-  int32_t maxVal = values[0];
-
-  for (int i = 0; i < count; i++) {
-    if (values[i] < minVal) minVal = values[i];
-    if (values[i] > maxVal) maxVal = values[i];
-  }
-
+  // min and max for scaling were tracked while reducing
+  int32_t minVal = data.lowest();
+  int32_t maxVal = data.highest();
   int32_t range = maxVal - minVal;
 
   // avoid division by zero if all values are the same
@@ -104,7 +98,7 @@ void drawSparkLine(
     range = 1;
   }
 
-  int32_t refVal = values[0]; // use first (oldest) value as reference point for coloring
+  int32_t refVal = data.first(); // use first (oldest) value as reference point for coloring
 
   // helper lambda to convert a value to Y coordinate
   // min maps to bottom (y + height), max maps to top (y)
@@ -118,11 +112,36 @@ void drawSparkLine(
   display.drawLine(x, (int16_t)refY, x + width, (int16_t)refY, GxEPD_BLACK);
 
   float segmentWidth = (float)width / (float)(count - 1);
-  for (int i = 0; i < count - 1; i++) {
+  for (int i = 0; i < count; i++) {
+    const SparkBucket& bucket = data.bucket(i);
     float x1 = x + (i * segmentWidth);
-    float y1 = valueToY(values[i]);
+
+    // several values share this pixel column, draw their full range as a 2px vertical stroke
+    if (bucket.min != bucket.max) {
+      int16_t top = (int16_t)valueToY(bucket.max);
+      int16_t bottom = (int16_t)valueToY(bucket.min);
+      int16_t ref = (int16_t)refY;
+
+      if (top < ref) {
+        int16_t end = min(bottom, ref);
+        display.drawLine((int16_t)x1, top, (int16_t)x1, end, GxEPD_GREEN);
+        display.drawLine((int16_t)x1 + 1, top, (int16_t)x1 + 1, end, GxEPD_GREEN);
+      }
+      if (bottom > ref) {
+        int16_t start = max(top, ref);
+        display.drawLine((int16_t)x1, start, (int16_t)x1, bottom, GxEPD_RED);
+        display.drawLine((int16_t)x1 + 1, start, (int16_t)x1 + 1, bottom, GxEPD_RED);
+      }
+    }
+
+    if (i == count - 1) {
+      break;
+    }
+
+    // connect the last value of this column to the last value of the next
+    float y1 = valueToY(bucket.last);
     float x2 = x + ((i + 1) * segmentWidth);
-    float y2 = valueToY(values[i + 1]);
+    float y2 = valueToY(data.bucket(i + 1).last);
 
     // break each segment into tiny sub-segments for proper color transitions
     int steps = (int)segmentWidth;
@@ -149,4 +168,4 @@ void drawSparkLine(
       display.drawLine((int16_t)sx1, (int16_t)sy1 + 1, (int16_t)sx2, (int16_t)sy2 + 1, color);
     }
   }
-}
\ No newline at end of file
+}
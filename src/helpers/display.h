@@ -3,6 +3,7 @@
 
 #include <GxEPD2_7C.h>
 #include <epd7c/GxEPD2_730c_GDEP073E01.h>
+#include "sparkline.h"
 
 using Display = GxEPD2_7C<GxEPD2_730c_GDEP073E01, GxEPD2_730c_GDEY073D46::HEIGHT / 8>;
 
@@ -38,15 +39,14 @@ void drawTriangle(
   uint16_t color
 );
 
-// draw a sparkline chart showing historical values
+// draw a sparkline chart from values already reduced to one bucket per pixel column
 void drawSparkLine(
   Display& display,
   int16_t x,
   int16_t y,
   int16_t width,
   int16_t height,
-  int32_t* values,
-  int count
+  const SparklineReducer& data
 );
 
 #endif
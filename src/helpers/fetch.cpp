@@ -0,0 +1,152 @@
+#include "fetch.h"
+#include "log.h"
+#include "transport.h"
+
+#define LATENCY_BUCKETS 6
+
+// upper bound of each latency bucket in ms, the last bucket catches everything slower
+static const uint16_t bucketLimits[LATENCY_BUCKETS - 1] = { 250, 500, 1000, 2000, 4000 };
+static const char* endpointNames[] = { "assets", "plaid", "gold", "btc", "transactions" };
+
+struct EndpointStats {
+  uint16_t buckets[LATENCY_BUCKETS]; // successful request latency
+  uint16_t failures; // requests that gave up without a 200
+  uint16_t retries;
+};
+
+// accumulated across wakes
+RTC_DATA_ATTR static EndpointStats endpointStats[(int)FetchEndpoint::Count];
+static bool endpointUsed[(int)FetchEndpoint::Count]; // requested during this wake
+
+static uint32_t budgetStart = 0;
+static uint32_t budgetMs = 0;
+
+const char* getEndpointName(FetchEndpoint endpoint) {
+  return endpointNames[(int)endpoint];
+}
+
+void beginFetchBudget(uint32_t budget) {
+  budgetStart = millis();
+  budgetMs = budget;
+}
+
+uint32_t getFetchBudgetRemaining() {
+  uint32_t elapsed = millis() - budgetStart;
+  return elapsed >= budgetMs ? 0 : budgetMs - elapsed;
+}
+
+static void recordLatency(FetchEndpoint endpoint, uint32_t ms) {
+  EndpointStats& stats = endpointStats[(int)endpoint];
+  int bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && ms >= bucketLimits[bucket]) {
+    bucket++;
+  }
+  if (stats.buckets[bucket] < UINT16_MAX) {
+    stats.buckets[bucket]++;
+  }
+}
+
+// connection failures, timeouts, rate limiting and server errors are worth another attempt
+static bool isTransient(int httpCode) {
+  return httpCode < 0 || httpCode == 429 || httpCode >= 500;
+}
+
+static int fetchOnce(
+  const FetchRequest& request,
+  uint32_t connectTimeoutMs,
+  uint32_t readTimeoutMs,
+  FetchBodyHandler& handler,
+  uint32_t& retryAfterMs
+) {
+  Transport& transport = getTransport();
+
+  int httpCode = transport.get(request, connectTimeoutMs, readTimeoutMs);
+  retryAfterMs = transport.retryAfterMs();
+
+  if (httpCode == HTTP_CODE_OK && !handler(transport.body())) {
+    httpCode = FETCH_ERROR_BODY;
+  }
+
+  transport.end();
+  return httpCode;
+}
+
+int fetchWithRetry(const FetchRequest& request, FetchBodyHandler handler) {
+  const char* name = endpointNames[(int)request.endpoint];
+  EndpointStats& stats = endpointStats[(int)request.endpoint];
+  endpointUsed[(int)request.endpoint] = true;
+  uint32_t reserve = request.optional ? FETCH_OPTIONAL_RESERVE_MS : 0;
+  uint32_t maxConnectTimeout = request.optional ? FETCH_OPTIONAL_TIMEOUT_MS : FETCH_CONNECT_TIMEOUT_MS;
+  uint32_t maxReadTimeout = request.optional ? FETCH_OPTIONAL_TIMEOUT_MS : FETCH_READ_TIMEOUT_MS;
+  int httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+
+  for (int attempt = 0; attempt < FETCH_MAX_ATTEMPTS; attempt++) {
+    uint32_t remaining = getFetchBudgetRemaining();
+    if (remaining <= reserve) {
+      LOG_WARN("fetch", "%s abandoned, %ums budget left", name, (unsigned)remaining);
+      break;
+    }
+
+    // never let a single attempt run past the wake deadline
+    uint32_t connectTimeoutMs = min(maxConnectTimeout, remaining - reserve);
+    uint32_t readTimeoutMs = min(maxReadTimeout, remaining - reserve);
+    uint32_t start = millis();
+    uint32_t retryAfterMs;
+    httpCode = fetchOnce(request, connectTimeoutMs, readTimeoutMs, handler, retryAfterMs);
+    uint32_t elapsed = millis() - start;
+
+    if (httpCode == HTTP_CODE_OK) {
+      recordLatency(request.endpoint, elapsed);
+      LOG_DEBUG("fetch", "%s ok in %ums", name, (unsigned)elapsed);
+      return httpCode;
+    }
+
+    LOG_WARN("fetch", "%s attempt %d failed, code: %d (%ums)", name, attempt + 1, httpCode, (unsigned)elapsed);
+
+    if (!isTransient(httpCode) || attempt == FETCH_MAX_ATTEMPTS - 1) {
+      break;
+    }
+
+    // exponential backoff with jitter, honoring Retry-After when the server sends one
+    uint32_t backoffMs = (FETCH_BACKOFF_BASE_MS << attempt) + (esp_random() % FETCH_BACKOFF_BASE_MS);
+    backoffMs = max(backoffMs, retryAfterMs);
+
+    if (backoffMs + reserve >= getFetchBudgetRemaining()) {
+      LOG_WARN("fetch", "%s giving up, backoff of %ums exceeds budget", name, (unsigned)backoffMs);
+      break;
+    }
+
+    stats.retries++;
+    delay(backoffMs);
+  }
+
+  stats.failures++;
+  return httpCode;
+}
+
+void logFetchStats() {
+  /*
+    one record per endpoint used this wake, "<name> <250/<500/<1k/<2k/<4k/+ ms fNN rNN", at most 62 characters
+    with every counter at UINT16_MAX so nothing is cut at LOG_MSG_LEN, and at WARN so release builds keep it
+  */
+  for (int i = 0; i < (int)FetchEndpoint::Count; i++) {
+    if (!endpointUsed[i]) {
+      continue;
+    }
+
+    const EndpointStats& stats = endpointStats[i];
+    LOG_WARN(
+      "fetch",
+      "%s %u/%u/%u/%u/%u/%u f%u r%u",
+      endpointNames[i],
+      stats.buckets[0],
+      stats.buckets[1],
+      stats.buckets[2],
+      stats.buckets[3],
+      stats.buckets[4],
+      stats.buckets[5],
+      stats.failures,
+      stats.retries
+    );
+  }
+}
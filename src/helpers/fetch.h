@@ -0,0 +1,54 @@
+#ifndef HELPERS_FETCH_H
+#define HELPERS_FETCH_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define FETCH_WAKE_BUDGET_MS 25000 // total network time allowed per wake
+#define FETCH_CONNECT_TIMEOUT_MS 5000
+#define FETCH_READ_TIMEOUT_MS 8000
+#define FETCH_OPTIONAL_TIMEOUT_MS 3000 // connect/read cap for optional quotes
+#define FETCH_OPTIONAL_RESERVE_MS 2000 // optional quotes are skipped once less than this budget remains
+#define FETCH_MAX_ATTEMPTS 3
+#define FETCH_BACKOFF_BASE_MS 300
+
+#define FETCH_ERROR_BODY (-100) // 200 response whose body handler failed (e.g. truncated payload)
+
+// endpoints tracked separately in the latency histograms
+enum class FetchEndpoint : uint8_t {
+  Assets,
+  Plaid,
+  Gold,
+  Bitcoin,
+  Transactions,
+  Count
+};
+
+// consumes the response body, returns false if it was unusable so the request can be retried
+using FetchBodyHandler = std::function<bool(Stream& body)>;
+
+struct FetchRequest {
+  FetchEndpoint endpoint;
+  const char* url;
+  bool authorize; // send the Lunch Money bearer token
+  bool optional; // abandon early instead of delaying the display refresh
+};
+
+// start the network budget for this wake
+void beginFetchBudget(uint32_t budgetMs = FETCH_WAKE_BUDGET_MS);
+
+// milliseconds left in this wake's network budget
+uint32_t getFetchBudgetRemaining();
+
+// GET the request url through the active transport, retrying transient failures with backoff while budget remains
+// the handler is called with the body of each 200 response
+// returns the final HTTP code (negative for transport errors or FETCH_ERROR_BODY)
+int fetchWithRetry(const FetchRequest& request, FetchBodyHandler handler);
+
+// short endpoint name for logs and fixture files, e.g. "assets"
+const char* getEndpointName(FetchEndpoint endpoint);
+
+// write the latency histograms, failures and retries of the endpoints used this wake to the log
+void logFetchStats();
+
+#endif
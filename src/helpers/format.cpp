@@ -1,74 +1,90 @@
 #include "format.h"
 #include <time.h>
 
-String formatCurrency(int32_t value) {
-  String result = "";
-  String numStr = String(abs(value));
-  int len = numStr.length();
+const char* formatCurrency(char* buffer, size_t size, int32_t value) {
+  // digits of the magnitude, least significant first (unsigned so INT32_MIN doesn't overflow)
+  char digits[10];
+  uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+  int len = 0;
+  do {
+    digits[len++] = '0' + (magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude > 0);
 
-  for (int i = 0; i < len; i++) {
-    if (i > 0 && (len - i) % 3 == 0) {
-      result += ',';
+  size_t pos = 0;
+  auto put = [&](char c) {
+    if (pos + 1 < size) {
+      buffer[pos++] = c;
     }
-    result += numStr[i];
+  };
+
+  if (value < 0) {
+    put('-');
   }
+  put('$');
 
-  return (value < 0 ? "-$" : "$") + result;
+  for (int i = len - 1; i >= 0; i--) {
+    put(digits[i]);
+    if (i > 0 && i % 3 == 0) {
+      put(',');
+    }
+  }
+
+  buffer[pos] = '\0';
+  return buffer;
 }
 
-String formatPossessive(const char* name) {
-  String nameStr = String(name);
-  int len = nameStr.length();
-  if (len > 0 && (nameStr[len - 1] == 's' || nameStr[len - 1] == 'S')) {
-    return nameStr + "'";
-  }
-  return nameStr + "'s";
+const char* formatPossessive(char* buffer, size_t size, const char* name) {
+  size_t len = strlen(name);
+  bool endsWithS = len > 0 && (name[len - 1] == 's' || name[len - 1] == 'S');
+  snprintf(buffer, size, "%s%s", name, endsWithS ? "'" : "'s");
+  return buffer;
 }
 
-String getFormattedTime() {
+const char* getFormattedTime(char* buffer, size_t size) {
   struct tm timeinfo;
   if (!getLocalTime(&timeinfo, 100)) {
-    return "Last updated: N/A";
+    snprintf(buffer, size, "Last updated: N/A");
+    return buffer;
   }
 
-  char buffer[32];
   int hour = timeinfo.tm_hour;
   const char* ampm = hour >= 12 ? "PM" : "AM";
   if (hour == 0) hour = 12;
   else if (hour > 12) hour -= 12;
 
-  snprintf(buffer, sizeof(buffer), "Last updated: %d:%02d %s", hour, timeinfo.tm_min, ampm);
-  return String(buffer);
+  snprintf(buffer, size, "Last updated: %d:%02d %s", hour, timeinfo.tm_min, ampm);
+  return buffer;
 }
 
-String getFormattedDate() {
+const char* getFormattedDate(char* buffer, size_t size) {
   struct tm timeinfo;
   if (!getLocalTime(&timeinfo, 100)) {
-    return "00-00-0000";
+    snprintf(buffer, size, "00-00-0000");
+    return buffer;
   }
 
-  char buffer[11];  // "MM-DD-YYYY\0"
   snprintf(
     buffer,
-    sizeof(buffer),
+    size,
     "%02d-%02d-%04d",
     timeinfo.tm_mon + 1,  // tm_mon is 0-based
     timeinfo.tm_mday,
     timeinfo.tm_year + 1900 // tm_year is years since 1900
   );
-  return String(buffer);
+  return buffer;
 }
 
-String formatPercentage(float value) {
+const char* formatPercentage(char* buffer, size_t size, float value) {
   float rounded = round(abs(value) * 10.0f) / 10.0f; // round to nearest tenth
 
   // check if it's a whole number (no decimal needed)
   if (rounded == (int)rounded) {
-    return String((int)rounded) + "%";
+    snprintf(buffer, size, "%d%%", (int)rounded);
+    return buffer;
   }
 
   // format with one decimal place
-  char buffer[16];
-  snprintf(buffer, sizeof(buffer), "%.1f%%", rounded);
-  return String(buffer);
+  snprintf(buffer, size, "%.1f%%", rounded);
+  return buffer;
 }
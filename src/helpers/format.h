@@ -3,19 +3,30 @@
 
 #include <Arduino.h>
 
+// buffer sizes that fit the longest possible output of each formatter
+#define CURRENCY_LEN 16 // "-$2,147,483,648\0"
+#define PERCENT_LEN 16
+#define TIME_LEN 32
+#define FORMATTED_DATE_LEN 11 // "MM-DD-YYYY\0"
+
+/*
+  all formatters write into a caller-supplied buffer (never the heap),
+  truncate to fit and return the buffer so they can be used inline
+*/
+
 // format an integer value as currency with commas (e.g., 123456 -> "$123,456")
-String formatCurrency(int32_t value);
+const char* formatCurrency(char* buffer, size_t size, int32_t value);
 
 // format a name with possessive suffix
-String formatPossessive(const char* name);
+const char* formatPossessive(char* buffer, size_t size, const char* name);
 
 // get the current time formatted as "Last updated: H:MM AM/PM"
-String getFormattedTime();
+const char* getFormattedTime(char* buffer, size_t size);
 
 // get the current date formatted as "MM-DD-YYYY" for database storage
-String getFormattedDate();
+const char* getFormattedDate(char* buffer, size_t size);
 
 // format a percentage value to nearest tenth, omitting .0 if whole number
-String formatPercentage(float value);
+const char* formatPercentage(char* buffer, size_t size, float value);
 
 #endif
@@ -0,0 +1,54 @@
+#include "heapguard.h"
+
+#ifdef HEAP_GUARD
+
+static volatile TaskHandle_t countedTask = nullptr;
+static volatile uint32_t allocationCount = 0;
+
+static inline void countAllocation() {
+  if (countedTask && xTaskGetCurrentTaskHandle() == countedTask) {
+    allocationCount++;
+  }
+}
+
+// the linker redirects every malloc/calloc/realloc call to these wrappers
+extern "C" {
+  void* __real_malloc(size_t size);
+  void* __real_calloc(size_t count, size_t size);
+  void* __real_realloc(void* ptr, size_t size);
+
+  void* __wrap_malloc(size_t size) {
+    countAllocation();
+    return __real_malloc(size);
+  }
+
+  void* __wrap_calloc(size_t count, size_t size) {
+    countAllocation();
+    return __real_calloc(count, size);
+  }
+
+  void* __wrap_realloc(void* ptr, size_t size) {
+    countAllocation();
+    return __real_realloc(ptr, size);
+  }
+}
+
+void beginAllocationCount() {
+  allocationCount = 0;
+  countedTask = xTaskGetCurrentTaskHandle();
+}
+
+uint32_t endAllocationCount() {
+  countedTask = nullptr;
+  return allocationCount;
+}
+
+#else
+
+void beginAllocationCount() {}
+
+uint32_t endAllocationCount() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HELPERS_HEAP_GUARD_H
+#define HELPERS_HEAP_GUARD_H
+
+#include <Arduino.h>
+
+/*
+  counts heap allocations made by the calling task between begin and end
+  only active when linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc and -DHEAP_GUARD
+  (set in the debug environment), otherwise end always returns 0
+*/
+
+void beginAllocationCount();
+
+// returns the number of malloc/calloc/realloc calls since beginAllocationCount()
+uint32_t endAllocationCount();
+
+#endif
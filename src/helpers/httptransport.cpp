@@ -0,0 +1,72 @@
+#include "httptransport.h"
+#include "log.h"
+#include "../credentials.h"
+
+int HttpTransport::get(const FetchRequest& request, uint32_t connectTimeoutMs, uint32_t readTimeoutMs) {
+  static const char* collected[] = { "Retry-After", "Content-Encoding" };
+
+  http.begin(request.url);
+  http.setConnectTimeout(connectTimeoutMs);
+  http.setTimeout(readTimeoutMs);
+  http.collectHeaders(collected, 2);
+
+  // HTTP/1.0 responses are never chunked, so the body can be streamed straight into the parser
+  http.useHTTP10(true);
+
+  // the token goes in as a const char*, HTTPClient writes "Authorization: Bearer <token>" itself
+  // instead of a "Bearer " + token String being built for addHeader on every request
+  // (the client is reused, so an unauthorised request clears what the last one set)
+  http.setAuthorizationType("Bearer");
+  http.setAuthorization(request.authorize ? LUNCH_MONEY_ACCESS_TOKEN : "");
+  if (request.authorize) {
+    http.addHeader("Content-Type", "application/json");
+  }
+
+  if (HTTP_ACCEPT_GZIP && !gzipDisabled) {
+    http.addHeader("Accept-Encoding", "gzip, deflate");
+  }
+
+  return http.GET();
+}
+
+Stream& HttpTransport::body() {
+  Stream& raw = http.getStream();
+  String encoding = http.header("Content-Encoding");
+
+  if (encoding != "gzip" && encoding != "deflate") {
+    return raw;
+  }
+
+  InflateFormat format = (encoding == "gzip") ? InflateFormat::Gzip : InflateFormat::Zlib;
+  if (!inflater.begin(raw, format)) {
+    // the body can't be decoded, retries will ask for it uncompressed
+    LOG_ERROR("http", "No memory for inflater, disabling compression");
+    gzipDisabled = true;
+    return raw;
+  }
+
+  inflating = true;
+  return inflater;
+}
+
+uint32_t HttpTransport::retryAfterMs() {
+  if (!http.hasHeader("Retry-After")) {
+    return 0;
+  }
+  return http.header("Retry-After").toInt() * 1000;
+}
+
+void HttpTransport::end() {
+  if (inflating) {
+    LOG_DEBUG(
+      "http",
+      "%u bytes on air, %u inflated (%u%%)",
+      (unsigned)inflater.compressedBytes(),
+      (unsigned)inflater.inflatedBytes(),
+      (unsigned)(inflater.inflatedBytes() ? inflater.compressedBytes() * 100 / inflater.inflatedBytes() : 0)
+    );
+    inflater.end();
+    inflating = false;
+  }
+  http.end();
+}
@@ -0,0 +1,29 @@
+#ifndef HELPERS_HTTPTRANSPORT_H
+#define HELPERS_HTTPTRANSPORT_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include "transport.h"
+#include "inflate.h"
+
+// ask servers for gzip/deflate bodies, set to 0 to compare transfer sizes and times uncompressed
+#ifndef HTTP_ACCEPT_GZIP
+  #define HTTP_ACCEPT_GZIP 1
+#endif
+
+// live requests over WiFi, compressed responses are inflated while they stream in
+class HttpTransport : public Transport {
+ public:
+  int get(const FetchRequest& request, uint32_t connectTimeoutMs, uint32_t readTimeoutMs) override;
+  Stream& body() override;
+  uint32_t retryAfterMs() override;
+  void end() override;
+
+ private:
+  HTTPClient http;
+  InflateStream inflater;
+  bool inflating = false;
+  bool gzipDisabled = false; // set if the inflater could not be allocated
+};
+
+#endif
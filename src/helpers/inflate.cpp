@@ -0,0 +1,185 @@
+#include "inflate.h"
+
+// gzip header flag bits (RFC 1952)
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+bool InflateStream::begin(Stream& src, InflateFormat fmt) {
+  end();
+
+  // the 32KB window is better off in PSRAM when the board has it
+  buffers = (Buffers*)(psramFound() ? ps_malloc(sizeof(Buffers)) : malloc(sizeof(Buffers)));
+  if (!buffers) {
+    return false;
+  }
+
+  tinfl_init(&buffers->inflator);
+  source = &src;
+  format = fmt;
+  status = TINFL_STATUS_NEEDS_MORE_INPUT;
+  headerDone = (fmt != InflateFormat::Gzip);
+  sourceDone = false;
+  inPos = inLen = 0;
+  dictOfs = outPos = outAvail = 0;
+  compressed = inflated = 0;
+  return true;
+}
+
+void InflateStream::end() {
+  free(buffers);
+  buffers = nullptr;
+  source = nullptr;
+  outAvail = 0;
+}
+
+void InflateStream::refillInput() {
+  // take whatever has arrived, or block (up to the stream timeout) for at least one byte
+  int pending = source->available();
+  size_t want = pending > 0 ? min((size_t)pending, (size_t)INFLATE_INPUT_SIZE) : 1;
+  size_t got = source->readBytes((char*)buffers->in, want);
+
+  inPos = 0;
+  inLen = got;
+  compressed += got;
+  if (got == 0) {
+    sourceDone = true;
+  }
+}
+
+int InflateStream::nextInputByte() {
+  if (inPos == inLen) {
+    refillInput();
+    if (sourceDone) {
+      return -1;
+    }
+  }
+  return buffers->in[inPos++];
+}
+
+bool InflateStream::skipGzipHeader() {
+  // magic, method (8 = deflate), flags, then mtime, extra flags and os which aren't needed
+  if (nextInputByte() != 0x1f || nextInputByte() != 0x8b || nextInputByte() != 8) {
+    return false;
+  }
+
+  int flags = nextInputByte();
+  for (int i = 0; i < 6; i++) {
+    nextInputByte();
+  }
+
+  if (flags & GZIP_FEXTRA) {
+    int extraLen = nextInputByte();
+    extraLen |= nextInputByte() << 8;
+    while (extraLen-- > 0) {
+      nextInputByte();
+    }
+  }
+
+  // zero-terminated file name and comment
+  if (flags & GZIP_FNAME) {
+    int c;
+    while ((c = nextInputByte()) > 0) {}
+  }
+  if (flags & GZIP_FCOMMENT) {
+    int c;
+    while ((c = nextInputByte()) > 0) {}
+  }
+
+  if (flags & GZIP_FHCRC) {
+    nextInputByte();
+    nextInputByte();
+  }
+
+  return !sourceDone;
+}
+
+// inflate until there is unread output, returns false at the end of the stream or on a corrupt one
+// the gzip trailer (crc32 + size) is left unread, a corrupt body already fails the JSON parse
+bool InflateStream::fill() {
+  if (!buffers) {
+    return false;
+  }
+
+  if (!headerDone) {
+    headerDone = true;
+    if (!skipGzipHeader()) {
+      status = TINFL_STATUS_FAILED;
+      return false;
+    }
+  }
+
+  while (outAvail == 0) {
+    if (status == TINFL_STATUS_DONE || status < 0) {
+      return false;
+    }
+
+    if (inPos == inLen && !sourceDone) {
+      refillInput();
+    }
+
+    uint32_t flags = (format == InflateFormat::Zlib) ? TINFL_FLAG_PARSE_ZLIB_HEADER : 0;
+    if (!sourceDone) {
+      flags |= TINFL_FLAG_HAS_MORE_INPUT;
+    }
+
+    size_t inBytes = inLen - inPos;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - dictOfs;
+    status = tinfl_decompress(
+      &buffers->inflator,
+      buffers->in + inPos,
+      &inBytes,
+      buffers->dict,
+      buffers->dict + dictOfs,
+      &outBytes,
+      flags
+    );
+
+    inPos += inBytes;
+    outPos = dictOfs;
+    outAvail = outBytes;
+    inflated += outBytes;
+    dictOfs = (dictOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+    // connection closed before the deflate stream ended
+    if (status == TINFL_STATUS_NEEDS_MORE_INPUT && sourceDone && outAvail == 0) {
+      status = TINFL_STATUS_FAILED;
+    }
+  }
+
+  return true;
+}
+
+int InflateStream::available() {
+  return fill() ? (int)outAvail : 0;
+}
+
+int InflateStream::read() {
+  if (!fill()) {
+    return -1;
+  }
+  outAvail--;
+  return buffers->dict[outPos++];
+}
+
+int InflateStream::peek() {
+  if (!fill()) {
+    return -1;
+  }
+  return buffers->dict[outPos];
+}
+
+size_t InflateStream::readBytes(char* buffer, size_t length) {
+  size_t copied = 0;
+
+  while (copied < length && fill()) {
+    size_t chunk = min(length - copied, outAvail);
+    memcpy(buffer + copied, buffers->dict + outPos, chunk);
+    outPos += chunk;
+    outAvail -= chunk;
+    copied += chunk;
+  }
+
+  return copied;
+}
@@ -0,0 +1,68 @@
+#ifndef HELPERS_INFLATE_H
+#define HELPERS_INFLATE_H
+
+#include <Arduino.h>
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/miniz.h"
+#else
+#include "rom/miniz.h"
+#endif
+
+#define INFLATE_INPUT_SIZE 1024
+
+enum class InflateFormat : uint8_t {
+  Gzip, // Content-Encoding: gzip
+  Zlib // Content-Encoding: deflate
+};
+
+// read-only stream that inflates a compressed source on the fly using the ROM inflater
+// only the 32KB sliding window is held in memory, never the whole decompressed body
+class InflateStream : public Stream {
+ public:
+  // allocate the inflater state and start reading from source, returns false if out of memory
+  bool begin(Stream& source, InflateFormat format);
+
+  // free the inflater state
+  void end();
+
+  // compressed bytes read from the source so far
+  size_t compressedBytes() const { return compressed; }
+
+  // decompressed bytes produced so far
+  size_t inflatedBytes() const { return inflated; }
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char* buffer, size_t length) override;
+  size_t write(uint8_t) override { return 0; }
+
+ private:
+  struct Buffers {
+    tinfl_decompressor inflator;
+    uint8_t dict[TINFL_LZ_DICT_SIZE];
+    uint8_t in[INFLATE_INPUT_SIZE];
+  };
+
+  bool fill();
+  void refillInput();
+  int nextInputByte();
+  bool skipGzipHeader();
+
+  Stream* source = nullptr;
+  Buffers* buffers = nullptr;
+  InflateFormat format = InflateFormat::Gzip;
+  tinfl_status status = TINFL_STATUS_DONE;
+  bool headerDone = false;
+  bool sourceDone = false;
+  size_t inPos = 0;
+  size_t inLen = 0;
+  size_t dictOfs = 0; // where the inflater writes next in the window
+  size_t outPos = 0; // next unread output byte in the window
+  size_t outAvail = 0;
+  size_t compressed = 0;
+  size_t inflated = 0;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "intraday.h"
+#include "log.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+
+/*
+  samples are collected in an RTC block and written to the ring file once it fills up, so flash
+  sees one block program every INTRADAY_BLOCK_SAMPLES wakes and the file never grows past
+  INTRADAY_BLOCKS blocks
+*/
+RTC_DATA_ATTR static IntradayBlock pending;
+RTC_DATA_ATTR static bool pendingFlushed = false; // pending was already written (flushIntraday) and is unchanged
+
+static uint32_t blockCrc(const IntradayBlock& block) {
+  return esp_rom_crc32_le(0, (const uint8_t*)&block, offsetof(IntradayBlock, crc));
+}
+
+static bool isBlockValid(const IntradayBlock& block) {
+  return block.magic == INTRADAY_MAGIC && block.count > 0 && block.count <= INTRADAY_BLOCK_SAMPLES && block.crc == blockCrc(block);
+}
+
+// visit every sample in a block, oldest first
+static void expandBlock(const IntradayBlock& block, const std::function<void(const IntradaySample&)>& visit) {
+  IntradaySample sample = { block.baseTime, block.baseValue };
+  visit(sample);
+
+  for (int i = 0; i < block.count - 1; i++) {
+    sample.time += block.deltas[i].minutes * 60;
+    sample.value += block.deltas[i].change;
+    visit(sample);
+  }
+}
+
+// highest sequence stored in the ring, returns false if the file has no valid block
+static bool findLatestSequence(uint32_t& sequence) {
+  File file = LittleFS.open(INTRADAY_FILE, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  bool found = false;
+  IntradayBlock block;
+  while (file.read((uint8_t*)&block, sizeof(IntradayBlock)) == sizeof(IntradayBlock)) {
+    if (isBlockValid(block) && (!found || block.sequence > sequence)) {
+      sequence = block.sequence;
+      found = true;
+    }
+  }
+  file.close();
+  return found;
+}
+
+static bool writeBlock(const IntradayBlock& block) {
+  bool exists = LittleFS.exists(INTRADAY_FILE);
+  File file = LittleFS.open(INTRADAY_FILE, exists ? "r+" : FILE_WRITE);
+  if (!file) {
+    LOG_ERROR("intraday", "Failed to open sample ring");
+    return false;
+  }
+
+  file.seek((block.sequence % INTRADAY_BLOCKS) * sizeof(IntradayBlock));
+  size_t written = file.write((uint8_t*)&block, sizeof(IntradayBlock));
+  file.close();
+
+  if (written != sizeof(IntradayBlock)) {
+    LOG_ERROR("intraday", "Failed to write sample block");
+    return false;
+  }
+  return true;
+}
+
+static void startBlock(uint32_t time, int32_t value) {
+  // RTC memory is cleared on power loss, so the next sequence comes from the ring itself
+  uint32_t sequence = 0;
+  bool hasPrevious = true;
+  if (pending.magic == INTRADAY_MAGIC) {
+    sequence = pending.sequence;
+  } else {
+    hasPrevious = findLatestSequence(sequence);
+  }
+
+  memset(&pending, 0, sizeof(IntradayBlock));
+  pending.magic = INTRADAY_MAGIC;
+  pending.sequence = hasPrevious ? sequence + 1 : 0;
+  pending.baseTime = time;
+  pending.baseValue = value;
+  pending.count = 1;
+  pendingFlushed = false;
+}
+
+bool addIntradaySample(uint32_t time, int32_t value) {
+  if (pending.magic != INTRADAY_MAGIC || pending.count == 0) {
+    startBlock(time, value);
+    return true;
+  }
+
+  // reconstruct the previous sample to delta against
+  IntradaySample last;
+  expandBlock(pending, [&](const IntradaySample& sample) {
+    last = sample;
+  });
+
+  uint32_t minutes = time > last.time ? (time - last.time + 30) / 60 : 0;
+  bool fits = pending.count < INTRADAY_BLOCK_SAMPLES && minutes <= UINT16_MAX && time >= last.time;
+
+  if (!fits) {
+    // a full block (or a gap too long to encode) goes to flash and the sample starts the next one
+    bool ok = pendingFlushed || writeBlock(pending);
+    startBlock(time, value);
+    return ok;
+  }
+
+  IntradayDelta& delta = pending.deltas[pending.count - 1];
+  delta.minutes = minutes;
+  delta.change = value - last.value;
+  pending.count++;
+  pending.crc = blockCrc(pending);
+  pendingFlushed = false;
+
+  if (pending.count == INTRADAY_BLOCK_SAMPLES) {
+    pendingFlushed = writeBlock(pending);
+    return pendingFlushed;
+  }
+  return true;
+}
+
+bool flushIntraday() {
+  if (pending.magic != INTRADAY_MAGIC || pending.count == 0 || pendingFlushed) {
+    return true;
+  }
+
+  pending.crc = blockCrc(pending);
+  pendingFlushed = writeBlock(pending);
+  return pendingFlushed;
+}
+
+int forEachIntradaySample(uint32_t since, const std::function<void(const IntradaySample&)>& visit) {
+  int visited = 0;
+  auto visitSince = [&](const IntradaySample& sample) {
+    if (sample.time >= since) {
+      visit(sample);
+      visited++;
+    }
+  };
+
+  // the ring is tiny (INTRADAY_BLOCKS blocks), load the valid blocks and walk them in sequence order
+  File file = LittleFS.open(INTRADAY_FILE, FILE_READ);
+  if (file) {
+    uint32_t latest = 0;
+    bool found = false;
+    IntradayBlock block;
+    while (file.read((uint8_t*)&block, sizeof(IntradayBlock)) == sizeof(IntradayBlock)) {
+      if (isBlockValid(block) && (!found || block.sequence > latest)) {
+        latest = block.sequence;
+        found = true;
+      }
+    }
+
+    // the pending block may already be in the ring (flushed early), it is read from RTC instead
+    bool pendingActive = pending.magic == INTRADAY_MAGIC && pending.count > 0;
+    uint32_t oldest = latest >= INTRADAY_BLOCKS - 1 ? latest - (INTRADAY_BLOCKS - 1) : 0;
+    for (uint32_t sequence = oldest; found && sequence <= latest; sequence++) {
+      if (pendingActive && sequence == pending.sequence) {
+        continue;
+      }
+
+      file.seek((sequence % INTRADAY_BLOCKS) * sizeof(IntradayBlock));
+      if (file.read((uint8_t*)&block, sizeof(IntradayBlock)) != sizeof(IntradayBlock) || !isBlockValid(block) || block.sequence != sequence) {
+        continue;
+      }
+
+      expandBlock(block, visitSince);
+    }
+    file.close();
+  }
+
+  if (pending.magic == INTRADAY_MAGIC && pending.count > 0) {
+    expandBlock(pending, visitSince);
+  }
+  return visited;
+}
+
+bool getIntradayValueAt(uint32_t time, IntradaySample& result) {
+  bool found = false;
+  forEachIntradaySample(0, [&](const IntradaySample& sample) {
+    if (sample.time <= time) {
+      result = sample;
+      found = true;
+    }
+  });
+  return found;
+}
+
+bool getIntradayChange(uint32_t now, uint32_t windowSeconds, uint32_t maxGapSeconds, float& percent) {
+  IntradaySample latest;
+  IntradaySample past;
+  uint32_t target = now - windowSeconds;
+  if (!getIntradayValueAt(now, latest) || !getIntradayValueAt(target, past) || past.value == 0) {
+    return false;
+  }
+  if (target - past.time > maxGapSeconds) {
+    return false;
+  }
+
+  percent = ((float)(latest.value - past.value) / (float)past.value) * 100.0f;
+  return true;
+}
@@ -0,0 +1,52 @@
+#ifndef HELPERS_INTRADAY_H
+#define HELPERS_INTRADAY_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define INTRADAY_FILE "/intraday.dat"
+#define INTRADAY_MAGIC 0x59444E49 // "INDY"
+#define INTRADAY_BLOCK_SAMPLES 16 // samples buffered in RTC memory per flash write (~2.5 days at a 4 hour cycle)
+#define INTRADAY_BLOCKS 32 // blocks in the ring file, the oldest is overwritten once it is full
+
+// one sample per wake, reconstructed from a block
+struct IntradaySample {
+  uint32_t time; // unix seconds
+  int32_t value; // net worth in whole dollars
+};
+
+// a sample stored relative to the one before it
+struct __attribute__((packed)) IntradayDelta {
+  uint16_t minutes; // minutes after the previous sample
+  int32_t change; // dollars changed since the previous sample
+};
+
+// fixed size ring slot, the first sample is stored in full and the rest as deltas
+struct IntradayBlock {
+  uint32_t magic;
+  uint32_t sequence; // increases with every block written, the slot is sequence % INTRADAY_BLOCKS
+  uint32_t baseTime;
+  int32_t baseValue;
+  uint8_t count; // samples in the block, including the base
+  IntradayDelta deltas[INTRADAY_BLOCK_SAMPLES - 1];
+  uint32_t crc; // crc32 of the bytes above
+};
+
+// buffer a sample in RTC memory, a full block is written to the ring file
+bool addIntradaySample(uint32_t time, int32_t value);
+
+// write the buffered samples now (e.g. before the battery dies), the partial block is kept for later samples
+bool flushIntraday();
+
+// call visit for each sample taken at or after since, oldest first, returns the number visited
+int forEachIntradaySample(uint32_t since, const std::function<void(const IntradaySample&)>& visit);
+
+// latest sample taken at or before time, returns false if there is none
+bool getIntradayValueAt(uint32_t time, IntradaySample& result);
+
+// percentage change between the latest sample and the last one taken windowSeconds before now
+// returns false if the ring doesn't reach back that far, or if that sample is more than maxGapSeconds older
+// (the device was off), so a longer move isn't labelled as the window
+bool getIntradayChange(uint32_t now, uint32_t windowSeconds, uint32_t maxGapSeconds, float& percent);
+
+#endif
@@ -0,0 +1,85 @@
+#include "log.h"
+#include <stdarg.h>
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "soc/usb_serial_jtag_struct.h"
+#endif
+
+RTC_DATA_ATTR static LogRecord logRing[LOG_RING_SIZE];
+RTC_DATA_ATTR static uint32_t logHead = 0; // total records ever written
+RTC_DATA_ATTR static uint32_t logFlushed = 0; // total records printed to serial
+RTC_DATA_ATTR static uint16_t wakeCount = 0;
+
+static const char levelChars[] = { '-', 'E', 'W', 'I', 'D' };
+
+static void printRecord(const LogRecord& record) {
+  LOG_SERIAL.printf(
+    "[%u +%ums] %c %s: %s\n",
+    (unsigned)record.wake,
+    (unsigned)record.ms,
+    levelChars[record.level],
+    record.tag,
+    record.msg
+  );
+}
+
+void initLog() {
+  wakeCount++;
+}
+
+void logWrite(uint8_t level, const char* tag, const char* format, ...) {
+  LogRecord& record = logRing[logHead % LOG_RING_SIZE];
+  record.wake = wakeCount;
+  record.level = level;
+  record.ms = millis();
+  strncpy(record.tag, tag, LOG_TAG_LEN - 1);
+  record.tag[LOG_TAG_LEN - 1] = '\0';
+
+  va_list args;
+  va_start(args, format);
+  vsnprintf(record.msg, LOG_MSG_LEN, format, args);
+  va_end(args);
+
+  logHead++;
+
+#if LOG_ECHO
+  printRecord(record);
+  logFlushed = logHead;
+#endif
+}
+
+bool isHostAttached() {
+#if CONFIG_IDF_TARGET_ESP32S3 && ARDUINO_USB_MODE
+  // the USB serial/JTAG peripheral counts start-of-frame packets, which only arrive (every 1ms) while a host is attached
+  uint32_t frame = USB_SERIAL_JTAG.fram_num.sof_frame_index;
+  delay(3);
+  return USB_SERIAL_JTAG.fram_num.sof_frame_index != frame;
+#else
+  // LOG_SERIAL is a UART, which can't tell if anything is listening
+  return true;
+#endif
+}
+
+void flushLog() {
+  if (logFlushed == logHead || !isHostAttached()) {
+    return;
+  }
+
+#if !LOG_ECHO
+  LOG_SERIAL.begin(115200);
+#endif
+
+  // oldest records were overwritten if the ring wrapped since the last flush
+  uint32_t pending = logHead - logFlushed;
+  if (pending > LOG_RING_SIZE) {
+    LOG_SERIAL.printf("(%u log records dropped)\n", (unsigned)(pending - LOG_RING_SIZE));
+    logFlushed = logHead - LOG_RING_SIZE;
+  }
+
+  while (logFlushed != logHead) {
+    printRecord(logRing[logFlushed % LOG_RING_SIZE]);
+    logFlushed++;
+  }
+
+  LOG_SERIAL.flush();
+}
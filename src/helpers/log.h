@@ -0,0 +1,86 @@
+#ifndef HELPERS_LOG_H
+#define HELPERS_LOG_H
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// compile-time log level, calls above this level are still type-checked but compiled out entirely
+#ifndef LOG_LEVEL
+  #ifdef RELEASE_BUILD
+    #define LOG_LEVEL LOG_LEVEL_WARN
+  #else
+    #define LOG_LEVEL LOG_LEVEL_DEBUG
+  #endif
+#endif
+
+// echo each record to serial as it is written, otherwise records wait in RTC memory until flushLog()
+#ifndef LOG_ECHO
+  #ifdef RELEASE_BUILD
+    #define LOG_ECHO 0
+  #else
+    #define LOG_ECHO 1
+  #endif
+#endif
+
+// port the log is printed on, the USB serial/JTAG port isHostAttached() watches when USB mode is on
+// (with CDC on boot off that port is USBSerial and Serial is UART0)
+#if ARDUINO_USB_MODE && !ARDUINO_USB_CDC_ON_BOOT
+  #define LOG_SERIAL USBSerial
+#else
+  #define LOG_SERIAL Serial
+#endif
+
+#define LOG_RING_SIZE 32 // records kept in RTC memory across deep sleep
+#define LOG_TAG_LEN 9 // longest tag ("backfill", "intraday") plus the terminator, fills the padding before ms
+#define LOG_MSG_LEN 64
+
+struct LogRecord {
+  uint16_t wake; // wake counter when the record was written
+  uint8_t level;
+  char tag[LOG_TAG_LEN]; // module name, e.g. "api"
+  uint32_t ms; // millis() since boot
+  char msg[LOG_MSG_LEN];
+};
+
+// start a new wake in the log (call once at the top of setup)
+void initLog();
+
+// append a record to the RTC ring buffer, use the LOG_* macros instead of calling this directly
+void logWrite(uint8_t level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+// check if a USB host is attached (a serial monitor could be listening)
+bool isHostAttached();
+
+// write any records not yet printed to serial, only if a host is attached
+void flushLog();
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+  #define LOG_ERROR(tag, ...) logWrite(LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#else
+  #define LOG_ERROR(tag, ...) do { if (false) logWrite(LOG_LEVEL_ERROR, tag, __VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+  #define LOG_WARN(tag, ...) logWrite(LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#else
+  #define LOG_WARN(tag, ...) do { if (false) logWrite(LOG_LEVEL_WARN, tag, __VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+  #define LOG_INFO(tag, ...) logWrite(LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#else
+  #define LOG_INFO(tag, ...) do { if (false) logWrite(LOG_LEVEL_INFO, tag, __VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+  #define LOG_DEBUG(tag, ...) logWrite(LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#else
+  #define LOG_DEBUG(tag, ...) do { if (false) logWrite(LOG_LEVEL_DEBUG, tag, __VA_ARGS__); } while (0)
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+#include "money.h"
+
+bool parseCents(const char* str, int64_t& cents) {
+  if (!str) {
+    return false;
+  }
+
+  bool negative = false;
+  if (*str == '-' || *str == '+') {
+    negative = (*str == '-');
+    str++;
+  }
+
+  int64_t whole = 0;
+  int digits = 0;
+  while (*str >= '0' && *str <= '9') {
+    whole = whole * 10 + (*str - '0');
+    str++;
+    digits++;
+  }
+
+  int64_t fraction = 0;
+  int fractionDigits = 0;
+  bool roundUp = false;
+  if (*str == '.') {
+    str++;
+    while (*str >= '0' && *str <= '9') {
+      if (fractionDigits < 2) {
+        fraction = fraction * 10 + (*str - '0');
+      } else if (fractionDigits == 2) {
+        roundUp = (*str >= '5');
+      }
+      str++;
+      fractionDigits++;
+      digits++;
+    }
+  }
+
+  if (digits == 0 || *str != '\0') {
+    return false;
+  }
+
+  // "12.5" is 50 cents, not 5
+  if (fractionDigits == 1) {
+    fraction *= 10;
+  }
+
+  int64_t result = whole * 100 + fraction + (roundUp ? 1 : 0);
+  cents = negative ? -result : result;
+  return true;
+}
+
+int64_t doubleToCents(double value) {
+  return (int64_t)llround(value * 100.0);
+}
+
+int32_t centsToDollars(int64_t cents) {
+  int64_t dollars = (cents >= 0) ? (cents + 50) / 100 : (cents - 50) / 100;
+  return (int32_t)dollars;
+}
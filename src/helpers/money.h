@@ -0,0 +1,17 @@
+#ifndef HELPERS_MONEY_H
+#define HELPERS_MONEY_H
+
+#include <Arduino.h>
+
+// parse a decimal amount string (e.g. "-1234.5600") into exact cents without floating point
+// fractional digits past the cents are rounded half away from zero
+// returns false if the string is not a plain decimal number
+bool parseCents(const char* str, int64_t& cents);
+
+// convert a JSON number that was already parsed as a double into cents
+int64_t doubleToCents(double value);
+
+// round cents to whole dollars, half away from zero
+int32_t centsToDollars(int64_t cents);
+
+#endif
@@ -0,0 +1,72 @@
+#include "plaidsync.h"
+#include "log.h"
+
+/*
+  the table lives in RTC memory and the plaid total is kept as a running sum, adjusted by the accounts
+  whose contribution moved since the last wake, which is what the change count in the log reports
+  every account is still parsed and classified each wake, the response has to be read in full anyway
+  after a power loss the table is empty and every account counts as changed once
+*/
+RTC_DATA_ATTR static PlaidSyncEntry entries[PLAID_SYNC_MAX];
+RTC_DATA_ATTR static uint8_t entryCount = 0;
+RTC_DATA_ATTR static int64_t syncedTotal = 0; // sum of every entry's cents
+
+static int64_t untrackedTotal = 0; // accounts that didn't fit in the table this wake
+static int changed = 0;
+
+static PlaidSyncEntry* findEntry(uint32_t id) {
+  for (int i = 0; i < entryCount; i++) {
+    if (entries[i].id == id) {
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+void beginPlaidSync() {
+  for (int i = 0; i < entryCount; i++) {
+    entries[i].seen = false;
+  }
+  untrackedTotal = 0;
+  changed = 0;
+}
+
+void syncPlaidBalance(uint32_t id, int64_t cents) {
+  PlaidSyncEntry* entry = findEntry(id);
+  if (!entry) {
+    changed++;
+    if (entryCount >= PLAID_SYNC_MAX) {
+      untrackedTotal += cents;
+      return;
+    }
+    entry = &entries[entryCount++];
+    entry->id = id;
+    entry->cents = 0;
+  } else if (entry->cents != cents) {
+    changed++;
+  }
+
+  syncedTotal += cents - entry->cents;
+  entry->cents = cents;
+  entry->seen = true;
+}
+
+int64_t endPlaidSync() {
+  // compact out accounts that were removed or closed
+  int kept = 0;
+  for (int i = 0; i < entryCount; i++) {
+    if (entries[i].seen) {
+      entries[kept++] = entries[i];
+    } else {
+      syncedTotal -= entries[i].cents;
+    }
+  }
+
+  if (kept != entryCount) {
+    LOG_DEBUG("plaid", "Dropped %d accounts", entryCount - kept);
+  }
+  entryCount = kept;
+
+  LOG_DEBUG("plaid", "%d of %d accounts changed", changed, entryCount);
+  return syncedTotal + untrackedTotal;
+}
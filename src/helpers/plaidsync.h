@@ -0,0 +1,24 @@
+#ifndef HELPERS_PLAIDSYNC_H
+#define HELPERS_PLAIDSYNC_H
+
+#include <Arduino.h>
+
+#define PLAID_SYNC_MAX 48 // accounts remembered between wakes, others are added to the total every wake
+
+// last seen signed contribution (cents) of one plaid account
+struct PlaidSyncEntry {
+  uint32_t id;
+  int64_t cents;
+  bool seen; // present in this wake's response
+};
+
+// start a sync pass over this wake's plaid accounts
+void beginPlaidSync();
+
+// record an account's contribution this wake, adjusting the running total by its change
+void syncPlaidBalance(uint32_t id, int64_t cents);
+
+// drop accounts missing from this wake's response and return the plaid total in cents
+int64_t endPlaidSync();
+
+#endif
@@ -1,6 +1,10 @@
 #include "power.h"
 #include "configuration.h"
 
+#ifndef BATTERY_CRITICAL_THRESHOLD
+  #define BATTERY_CRITICAL_THRESHOLD 5
+#endif
+
 void initBattery() {
   pinMode(BATTERY_ENABLE_PIN, OUTPUT);
   digitalWrite(BATTERY_ENABLE_PIN, LOW);
@@ -26,3 +30,7 @@ int getBatteryPercent() {
 bool isBatteryLow() {
   return getBatteryPercent() <= BATTERY_LOW_THRESHOLD;
 }
+
+bool isBatteryCritical() {
+  return getBatteryPercent() <= BATTERY_CRITICAL_THRESHOLD;
+}
@@ -18,4 +18,7 @@ int getBatteryPercent();
 // check if battery is low (< BATTERY_LOW_THRESHOLD)
 bool isBatteryLow();
 
+// check if battery is critical (<= BATTERY_CRITICAL_THRESHOLD), pending data should be written out
+bool isBatteryCritical();
+
 #endif
@@ -0,0 +1,152 @@
+#include "profile.h"
+#include "log.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+
+/*
+  finished profiles are collected in RTC memory and written to the ring file a batch at a time, so the
+  log costs one flash write every WAKE_PROFILE_BATCH wakes instead of a block rewrite every wake
+  a power loss drops the unwritten batch
+*/
+RTC_DATA_ATTR static WakeProfile batch[WAKE_PROFILE_BATCH];
+RTC_DATA_ATTR static uint8_t batchCount = 0;
+RTC_DATA_ATTR static uint8_t batchFlushed = 0; // leading profiles of the batch already written (flushWakeProfiles)
+RTC_DATA_ATTR static uint32_t lastSequence = 0; // 0 after a power loss, read back from the ring
+
+static WakeProfile current;
+
+void markPhase(const char* name) {
+  if (current.phaseCount >= PROFILE_MAX_PHASES) {
+    return;
+  }
+
+  PhaseSample& sample = current.phases[current.phaseCount++];
+  strncpy(sample.name, name, PHASE_NAME_LEN - 1);
+  sample.name[PHASE_NAME_LEN - 1] = '\0';
+  sample.ms = millis();
+  sample.freeHeap = ESP.getFreeHeap();
+  sample.largestBlock = ESP.getMaxAllocHeap();
+  sample.freePsram = psramFound() ? ESP.getFreePsram() : 0;
+  sample.stackHighWater = uxTaskGetStackHighWaterMark(NULL);
+
+  LOG_DEBUG(
+    "prof",
+    "%s +%ums heap %u (max %u) psram %u stack %u",
+    sample.name,
+    (unsigned)sample.ms,
+    (unsigned)sample.freeHeap,
+    (unsigned)sample.largestBlock,
+    (unsigned)sample.freePsram,
+    (unsigned)sample.stackHighWater
+  );
+}
+
+static uint32_t profileCrc(const WakeProfile& profile) {
+  return esp_rom_crc32_le(0, (const uint8_t*)&profile, offsetof(WakeProfile, crc));
+}
+
+static bool isProfileValid(const WakeProfile& profile, uint32_t slot) {
+  return profile.sequence > 0 && profile.sequence % WAKE_LOG_ENTRIES == slot && profile.phaseCount <= PROFILE_MAX_PHASES && profile.crc == profileCrc(profile);
+}
+
+// highest sequence stored in the ring, 0 if the file has no valid profile
+static uint32_t findLatestSequence(File& file) {
+  uint32_t latest = 0;
+  WakeProfile profile;
+  file.seek(0);
+  for (uint32_t slot = 0; file.read((uint8_t*)&profile, sizeof(WakeProfile)) == sizeof(WakeProfile); slot++) {
+    if (isProfileValid(profile, slot) && profile.sequence > latest) {
+      latest = profile.sequence;
+    }
+  }
+  return latest;
+}
+
+// write batch[from, batchCount) to their ring slots with a single open
+static bool writeBatch(int from) {
+  bool exists = LittleFS.exists(WAKE_LOG_FILE);
+  File file = LittleFS.open(WAKE_LOG_FILE, exists ? "r+" : FILE_WRITE);
+  if (!file) {
+    LOG_ERROR("prof", "Failed to open wake log");
+    return false;
+  }
+
+  bool ok = true;
+  for (int i = from; i < batchCount && ok; i++) {
+    file.seek((batch[i].sequence % WAKE_LOG_ENTRIES) * sizeof(WakeProfile));
+    ok = file.write((uint8_t*)&batch[i], sizeof(WakeProfile)) == sizeof(WakeProfile);
+  }
+  file.close();
+
+  if (!ok) {
+    LOG_ERROR("prof", "Failed to write wake log");
+  }
+  return ok;
+}
+
+bool saveWakeProfile() {
+  // RTC memory is cleared on power loss, so the next sequence comes from the ring itself
+  if (lastSequence == 0) {
+    File file = LittleFS.open(WAKE_LOG_FILE, FILE_READ);
+    if (file) {
+      lastSequence = findLatestSequence(file);
+      file.close();
+    }
+  }
+
+  current.sequence = ++lastSequence;
+  current.crc = profileCrc(current);
+  batch[batchCount++] = current;
+  if (batchCount < WAKE_PROFILE_BATCH) {
+    return true;
+  }
+
+  // the batch starts over even if the write failed, the log is diagnostics and not worth retrying
+  bool ok = writeBatch(batchFlushed);
+  batchCount = 0;
+  batchFlushed = 0;
+  return ok;
+}
+
+bool flushWakeProfiles() {
+  if (batchFlushed == batchCount) {
+    return true;
+  }
+
+  bool ok = writeBatch(batchFlushed);
+  if (ok) {
+    batchFlushed = batchCount;
+  }
+  return ok;
+}
+
+int forEachWakeProfile(const std::function<void(const WakeProfile&)>& visit) {
+  int visited = 0;
+
+  // buffered profiles are visited from RTC memory, the flushed ones are in the ring as well
+  uint32_t firstBuffered = batchCount > 0 ? batch[0].sequence : UINT32_MAX;
+
+  File file = LittleFS.open(WAKE_LOG_FILE, FILE_READ);
+  if (file) {
+    uint32_t latest = findLatestSequence(file);
+    uint32_t oldest = latest >= WAKE_LOG_ENTRIES ? latest - (WAKE_LOG_ENTRIES - 1) : 1;
+    WakeProfile profile;
+    for (uint32_t sequence = oldest; latest > 0 && sequence <= latest && sequence < firstBuffered; sequence++) {
+      uint32_t slot = sequence % WAKE_LOG_ENTRIES;
+      file.seek(slot * sizeof(WakeProfile));
+      if (file.read((uint8_t*)&profile, sizeof(WakeProfile)) != sizeof(WakeProfile) || !isProfileValid(profile, slot) || profile.sequence != sequence) {
+        continue;
+      }
+
+      visit(profile);
+      visited++;
+    }
+    file.close();
+  }
+
+  for (int i = 0; i < batchCount; i++) {
+    visit(batch[i]);
+    visited++;
+  }
+  return visited;
+}
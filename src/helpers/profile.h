@@ -0,0 +1,44 @@
+#ifndef HELPERS_PROFILE_H
+#define HELPERS_PROFILE_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define WAKE_LOG_FILE "/wake.log"
+#define WAKE_LOG_ENTRIES 64 // wakes kept in the log before the oldest is overwritten
+#define WAKE_PROFILE_BATCH 4 // wakes buffered in RTC memory per flash write (16 hours at a 4 hour cycle)
+#define PROFILE_MAX_PHASES 8
+#define PHASE_NAME_LEN 8
+
+// timing and memory snapshot taken at the end of a wake phase
+struct PhaseSample {
+  char name[PHASE_NAME_LEN];
+  uint32_t ms; // millis() since boot
+  uint32_t freeHeap;
+  uint32_t largestBlock; // largest allocatable heap block
+  uint32_t freePsram;
+  uint32_t stackHighWater; // bytes of the loop task stack that have never been used
+};
+
+// one slot of the wake log ring, the slot is sequence % WAKE_LOG_ENTRIES
+struct WakeProfile {
+  uint32_t sequence; // increments every wake, survives power loss
+  uint8_t phaseCount;
+  PhaseSample phases[PROFILE_MAX_PHASES];
+  uint32_t crc; // crc32 of the bytes above
+};
+
+// sample timing and memory at a phase boundary of setup() (e.g. "wifi", "render")
+void markPhase(const char* name);
+
+// buffer this wake's phase samples in RTC memory, a full batch is written to the wake log on LittleFS
+// (call after initDatabase)
+bool saveWakeProfile();
+
+// write the buffered profiles now (e.g. before the battery dies)
+bool flushWakeProfiles();
+
+// call visit for each logged wake, oldest first, returns the number visited
+int forEachWakeProfile(const std::function<void(const WakeProfile&)>& visit);
+
+#endif
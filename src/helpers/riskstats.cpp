@@ -0,0 +1,58 @@
+#include "riskstats.h"
+#include <math.h>
+
+void addRiskPoint(RiskStats& stats, int32_t dayNumber, int32_t netWorth) {
+  if (stats.days == 0) {
+    memset(&stats, 0, sizeof(RiskStats));
+    stats.firstDay = dayNumber;
+    stats.firstValue = netWorth;
+    stats.peakValue = netWorth;
+    stats.peakDay = dayNumber;
+  } else if (stats.lastValue > 0) {
+    // a missed day folds into one longer step rather than being spread out
+    double dailyReturn = (double)netWorth / stats.lastValue - 1.0;
+    stats.returns++;
+    double delta = dailyReturn - stats.meanReturn;
+    stats.meanReturn += delta / stats.returns;
+    stats.m2 += delta * (dailyReturn - stats.meanReturn);
+  }
+
+  if (netWorth >= stats.peakValue) {
+    stats.peakValue = netWorth;
+    stats.peakDay = dayNumber;
+  } else if (stats.peakValue > 0) {
+    float drawdown = (float)(stats.peakValue - netWorth) / stats.peakValue;
+    if (drawdown > stats.maxDrawdown) {
+      stats.maxDrawdown = drawdown;
+      stats.drawdownPeakDay = stats.peakDay;
+      stats.drawdownTroughDay = dayNumber;
+    }
+  }
+
+  stats.lastDay = dayNumber;
+  stats.lastValue = netWorth;
+  stats.days++;
+}
+
+bool getRiskSummary(const RiskStats& stats, RiskSummary& summary) {
+  memset(&summary, 0, sizeof(RiskSummary));
+  if (stats.returns < 2) {
+    return false;
+  }
+
+  // annualized by the steps actually taken per year, so gaps in the history don't shrink it
+  int32_t span = stats.lastDay - stats.firstDay;
+  double stepsPerYear = span > 0 ? (double)(stats.days - 1) * 365.0 / span : 365.0;
+  summary.volatility = (float)(sqrt(stats.m2 / (stats.returns - 1)) * sqrt(stepsPerYear));
+
+  summary.maxDrawdown = stats.maxDrawdown;
+  if (stats.peakValue > 0 && stats.lastValue < stats.peakValue) {
+    summary.currentDrawdown = (float)(stats.peakValue - stats.lastValue) / stats.peakValue;
+  }
+
+  summary.hasCagr = span >= RISK_CAGR_MIN_DAYS && stats.firstValue > 0 && stats.lastValue > 0;
+  if (summary.hasCagr) {
+    summary.cagr = (float)(pow((double)stats.lastValue / stats.firstValue, 365.0 / span) - 1.0);
+  }
+  return true;
+}
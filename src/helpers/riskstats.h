@@ -0,0 +1,43 @@
+#ifndef HELPERS_RISKSTATS_H
+#define HELPERS_RISKSTATS_H
+
+#include <Arduino.h>
+
+#define RISK_CAGR_MIN_DAYS 365 // annualizing a shorter history overstates it
+
+/*
+  running risk statistics over the daily history, each newer day folds in with O(1) work:
+  Welford mean and variance of the day-over-day returns, the running peak and the deepest
+  drawdown from it, and the first day for the compound growth rate
+*/
+struct RiskStats {
+  int32_t firstDay;
+  int32_t firstValue;
+  int32_t lastDay;
+  int32_t lastValue;
+  int32_t days; // points folded in
+  int32_t returns; // returns folded in, a step from a value <= 0 has none
+  double meanReturn;
+  double m2; // sum of squared deviations from the mean return
+  int32_t peakValue;
+  int32_t peakDay;
+  float maxDrawdown; // deepest fall from a positive peak, 0.25 = 25%
+  int32_t drawdownPeakDay; // where the deepest drawdown started
+  int32_t drawdownTroughDay; // and bottomed out
+};
+
+struct RiskSummary {
+  float volatility; // annualized standard deviation of returns, 0.15 = 15%
+  float maxDrawdown;
+  float currentDrawdown; // below the running peak right now
+  float cagr; // compound annual growth since the first day
+  bool hasCagr; // false under RISK_CAGR_MIN_DAYS of history or without positive endpoints
+};
+
+// fold in the next day, which must be later than every day before it
+void addRiskPoint(RiskStats& stats, int32_t dayNumber, int32_t netWorth);
+
+// derive the display figures, returns false until there are two returns
+bool getRiskSummary(const RiskStats& stats, RiskSummary& summary);
+
+#endif
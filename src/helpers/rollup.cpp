@@ -0,0 +1,259 @@
+#include "rollup.h"
+#include "calendar.h"
+#include "database.h"
+#include "log.h"
+
+#define ROLLUP_TIERS 2
+
+static const char* tierFiles[ROLLUP_TIERS] = { ROLLUP_WEEK_FILE, ROLLUP_MONTH_FILE };
+
+int32_t getRollupPeriod(RollupTier tier, int32_t dayNumber) {
+  if (tier == RollupTier::Week) {
+    return dayNumber - weekdayOf(dayNumber);
+  }
+
+  int year, month, day;
+  civilFromDays(dayNumber, year, month, day);
+  return year * 12 + month - 1;
+}
+
+static void startPeriod(RollupRecord& rollup, int32_t period, int32_t netWorth) {
+  rollup = { period, netWorth, netWorth, netWorth, netWorth, 1 };
+}
+
+static void extendPeriod(RollupRecord& rollup, int32_t netWorth) {
+  rollup.close = netWorth;
+  rollup.low = min(rollup.low, netWorth);
+  rollup.high = max(rollup.high, netWorth);
+  rollup.days++;
+}
+
+// first and last day number of a period
+static void getPeriodDays(RollupTier tier, int32_t period, int32_t& first, int32_t& last) {
+  if (tier == RollupTier::Week) {
+    first = period;
+    last = period + 6;
+    return;
+  }
+
+  int year = period / 12;
+  int month = period % 12 + 1;
+  first = daysFromCivil(year, month, 1);
+  last = (month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, month + 1, 1)) - 1;
+}
+
+// recompute a period from its daily records on flash
+// (a period is at most 31 days, found with a binary search, so this never reads far)
+static bool recomputePeriod(RollupTier tier, RollupRecord& rollup) {
+  int32_t period = rollup.period;
+  int32_t first, last;
+  getPeriodDays(tier, period, first, last);
+
+  bool found = false;
+  HistoryCursor cursor(findNetWorthIndex(first), getStoredRecordCount(), false);
+  while (const DailyNetWorth* record = cursor.next()) {
+    if (cursor.day() > last) {
+      break;
+    }
+    if (cursor.day() < first) {
+      continue;
+    }
+    if (found) {
+      extendPeriod(rollup, record->netWorth);
+    } else {
+      startPeriod(rollup, period, record->netWorth);
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+// index of a period in a tier file holding count rollups, -1 if it has none (periods are stored in order)
+static int findPeriod(File& file, size_t count, int32_t period) {
+  int low = 0;
+  int high = (int)count - 1;
+  RollupRecord rollup;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    file.seek(mid * sizeof(RollupRecord));
+    if (file.read((uint8_t*)&rollup, sizeof(RollupRecord)) != sizeof(RollupRecord)) {
+      return -1;
+    }
+    if (rollup.period == period) {
+      return mid;
+    }
+    if (rollup.period < period) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return -1;
+}
+
+static bool updateTier(RollupTier tier, int32_t dayNumber, int32_t netWorth, bool replacedDay) {
+  const char* path = tierFiles[(int)tier];
+  int32_t period = getRollupPeriod(tier, dayNumber);
+
+  bool exists = LittleFS.exists(path);
+  File file = LittleFS.open(path, exists ? "r+" : FILE_WRITE);
+  if (!file) {
+    LOG_ERROR("rollup", "Failed to open %s", path);
+    return false;
+  }
+
+  RollupRecord last;
+  size_t count = file.size() / sizeof(RollupRecord);
+  bool hasLast = count > 0;
+  if (hasLast) {
+    file.seek((count - 1) * sizeof(RollupRecord));
+    hasLast = file.read((uint8_t*)&last, sizeof(RollupRecord)) == sizeof(RollupRecord);
+  }
+
+  size_t writeIndex = count;
+  RollupRecord rollup;
+
+  if (hasLast && last.period == period) {
+    writeIndex = count - 1;
+    rollup = last;
+    if (replacedDay) {
+      recomputePeriod(tier, rollup);
+    } else {
+      extendPeriod(rollup, netWorth);
+    }
+  } else if (!hasLast || last.period < period) {
+    startPeriod(rollup, period, netWorth);
+  } else {
+    // a corrected day in an older period (e.g. by backfill) only changes that period
+    // (a new older day never gets here, inserting one rebuilds the rollups)
+    int index = replacedDay ? findPeriod(file, count, period) : -1;
+    rollup.period = period;
+    if (index < 0 || !recomputePeriod(tier, rollup)) {
+      file.close();
+      return false;
+    }
+    writeIndex = index;
+  }
+
+  file.seek(writeIndex * sizeof(RollupRecord));
+  size_t written = file.write((uint8_t*)&rollup, sizeof(RollupRecord));
+  file.close();
+
+  return written == sizeof(RollupRecord);
+}
+
+bool updateRollups(int32_t dayNumber, int32_t netWorth, bool replacedDay) {
+  bool ok = true;
+  for (int tier = 0; tier < ROLLUP_TIERS; tier++) {
+    ok = updateTier((RollupTier)tier, dayNumber, netWorth, replacedDay) && ok;
+  }
+
+  if (!ok) {
+    LOG_WARN("rollup", "Incremental update failed, rebuilding");
+    return rebuildRollups();
+  }
+  return true;
+}
+
+bool rebuildRollups() {
+  File files[ROLLUP_TIERS];
+  RollupRecord current[ROLLUP_TIERS];
+  bool started[ROLLUP_TIERS] = { false, false };
+  bool ok = true;
+
+  for (int tier = 0; tier < ROLLUP_TIERS; tier++) {
+    files[tier] = LittleFS.open(tierFiles[tier], FILE_WRITE);
+    ok = ok && files[tier];
+  }
+
+  if (ok) {
+    forEachStoredNetWorth(INT_MAX, [&](const DailyNetWorth& record) {
+      int32_t day;
+      if (!parseDayNumber(record.date, day)) {
+        return;
+      }
+
+      for (int tier = 0; tier < ROLLUP_TIERS; tier++) {
+        int32_t period = getRollupPeriod((RollupTier)tier, day);
+        if (started[tier] && current[tier].period == period) {
+          extendPeriod(current[tier], record.netWorth);
+          continue;
+        }
+        if (started[tier]) {
+          files[tier].write((uint8_t*)&current[tier], sizeof(RollupRecord));
+        }
+        startPeriod(current[tier], period, record.netWorth);
+        started[tier] = true;
+      }
+    });
+
+    for (int tier = 0; tier < ROLLUP_TIERS; tier++) {
+      if (started[tier]) {
+        files[tier].write((uint8_t*)&current[tier], sizeof(RollupRecord));
+      }
+    }
+  }
+
+  for (int tier = 0; tier < ROLLUP_TIERS; tier++) {
+    if (files[tier]) {
+      files[tier].close();
+    }
+  }
+
+  if (!ok) {
+    LOG_ERROR("rollup", "Failed to rebuild rollups");
+  } else {
+    LOG_INFO("rollup", "Rebuilt rollups");
+  }
+  return ok;
+}
+
+int forEachRecentRollup(RollupTier tier, int maxPeriods, const std::function<void(const RollupRecord&)>& visit) {
+  const char* path = tierFiles[(int)tier];
+  if (!LittleFS.exists(path)) {
+    return 0;
+  }
+
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) {
+    return 0;
+  }
+
+  int total = file.size() / sizeof(RollupRecord);
+  int toRead = min(maxPeriods, total);
+  file.seek((total - toRead) * sizeof(RollupRecord));
+
+  RollupRecord chunk[16];
+  int visited = 0;
+  while (visited < toRead) {
+    int want = min(16, toRead - visited);
+    int got = file.read((uint8_t*)chunk, want * sizeof(RollupRecord)) / sizeof(RollupRecord);
+    for (int i = 0; i < got; i++) {
+      visit(chunk[i]);
+    }
+    visited += got;
+    if (got < want) {
+      break;
+    }
+  }
+
+  file.close();
+  return visited;
+}
+
+int getRollupCount(RollupTier tier) {
+  const char* path = tierFiles[(int)tier];
+  if (!LittleFS.exists(path)) {
+    return 0;
+  }
+
+  File file = LittleFS.open(path, FILE_READ);
+  if (!file) {
+    return 0;
+  }
+
+  int count = file.size() / sizeof(RollupRecord);
+  file.close();
+  return count;
+}
@@ -0,0 +1,41 @@
+#ifndef HELPERS_ROLLUP_H
+#define HELPERS_ROLLUP_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define ROLLUP_WEEK_FILE "/rollup_week.dat"
+#define ROLLUP_MONTH_FILE "/rollup_month.dat"
+
+enum class RollupTier : uint8_t {
+  Week, // Monday through Sunday
+  Month
+};
+
+// open/close/low/high of the daily net worth values within one period
+struct RollupRecord {
+  int32_t period; // week: day number of its Monday, month: year * 12 + month - 1
+  int32_t open;
+  int32_t close;
+  int32_t low;
+  int32_t high;
+  int32_t days; // daily records in the period
+};
+
+// period key containing a day number
+int32_t getRollupPeriod(RollupTier tier, int32_t dayNumber);
+
+// fold a saved daily value into the latest period of every tier
+// appends are O(1), a replaced day re-reads only its own period's daily records
+bool updateRollups(int32_t dayNumber, int32_t netWorth, bool replacedDay);
+
+// rebuild every tier from a single pass over the daily records
+bool rebuildRollups();
+
+// call visit for each of the last maxPeriods rollups of a tier, oldest first, returns the number visited
+int forEachRecentRollup(RollupTier tier, int maxPeriods, const std::function<void(const RollupRecord&)>& visit);
+
+// number of periods stored for a tier
+int getRollupCount(RollupTier tier);
+
+#endif
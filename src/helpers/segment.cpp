@@ -0,0 +1,614 @@
+#include "segment.h"
+#include "series.h"
+#include "calendar.h"
+#include "log.h"
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include <unistd.h>
+
+struct DbDirectoryHeader {
+  uint32_t magic;
+  uint16_t count;
+  uint16_t reserved;
+  uint32_t crc; // crc32 of the entries that follow
+};
+
+static DbSegment segments[DB_MAX_SEGMENTS];
+static int segmentCount = 0;
+
+// sealed segments never change, so the last one read stays open for sequential and repeated reads
+static File cachedFile;
+static int32_t cachedYear = -1;
+
+static void closeCache() {
+  if (cachedFile) {
+    cachedFile.close();
+  }
+  cachedYear = -1;
+}
+
+const char* getSegmentPath(char* buffer, size_t size, int32_t year, SegmentFormat format) {
+  snprintf(buffer, size, DB_SEGMENT_DIR "/%d.%s", (int)year, format == SegmentFormat::Series ? "nws" : "dat");
+  return buffer;
+}
+
+static int32_t yearOf(int32_t dayNumber) {
+  int year, month, day;
+  civilFromDays(dayNumber, year, month, day);
+  return year;
+}
+
+static void updateIndexes() {
+  int32_t index = 0;
+  for (int i = 0; i < segmentCount; i++) {
+    segments[i].firstIndex = index;
+    index += segments[i].count;
+  }
+}
+
+static bool saveDirectory() {
+  DbDirectoryHeader header = { DB_DIRECTORY_MAGIC, (uint16_t)segmentCount, 0, 0 };
+  header.crc = esp_rom_crc32_le(0, (const uint8_t*)segments, segmentCount * sizeof(DbSegment));
+
+  File file = LittleFS.open(DB_DIRECTORY_FILE, FILE_WRITE);
+  if (!file) {
+    LOG_ERROR("seg", "Failed to open segment directory");
+    return false;
+  }
+
+  bool ok = file.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+  ok = ok && file.write((uint8_t*)segments, segmentCount * sizeof(DbSegment)) == segmentCount * sizeof(DbSegment);
+  file.close();
+  return ok;
+}
+
+// day of the first (or last) record in a raw segment that passes its crc, stepping past torn or corrupt ones
+static bool findValidDay(File& file, int count, bool fromEnd, int32_t& day) {
+  DailyNetWorth record;
+  for (int i = 0; i < count; i++) {
+    file.seek((fromEnd ? count - 1 - i : i) * sizeof(DailyNetWorth));
+    if (file.read((uint8_t*)&record, sizeof(DailyNetWorth)) == sizeof(DailyNetWorth) && isRecordValid(record) && parseDayNumber(record.date, day)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// read a segment file's record count and day range, returns false only if the file is missing or empty
+// torn or corrupt records keep their slots (recoverTail and compaction deal with them), the range comes from valid ones
+static bool scanSegment(DbSegment& segment) {
+  char path[24];
+  File file = LittleFS.open(getSegmentPath(path, sizeof(path), segment.year, segment.format), FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  if (segment.format == SegmentFormat::Series) {
+    int count;
+    bool ok = scanSeries(file, count, segment.firstDay, segment.lastDay);
+    file.close();
+    segment.count = count;
+    return ok;
+  }
+
+  segment.count = file.size() / sizeof(DailyNetWorth);
+  bool dated = segment.count > 0 && findValidDay(file, segment.count, false, segment.firstDay);
+  dated = dated && findValidDay(file, segment.count, true, segment.lastDay);
+  file.close();
+
+  // nothing readable at all, the year itself still bounds the searches
+  if (segment.count > 0 && !dated) {
+    segment.firstDay = daysFromCivil(segment.year, 1, 1);
+    segment.lastDay = segment.firstDay;
+  }
+  return segment.count > 0;
+}
+
+// an append torn mid-record leaves bytes that would misalign every later record
+static void trimPartialRecord(const DbSegment& segment) {
+  if (segment.format != SegmentFormat::Raw) {
+    return;
+  }
+
+  char path[24];
+  File file = LittleFS.open(getSegmentPath(path, sizeof(path), segment.year), FILE_READ);
+  size_t size = file ? file.size() : 0;
+  if (file) {
+    file.close();
+  }
+
+  if (size % sizeof(DailyNetWorth) == 0) {
+    return;
+  }
+
+  char fullPath[32];
+  snprintf(fullPath, sizeof(fullPath), DB_MOUNT_POINT "%s", path);
+  if (truncate(fullPath, segment.count * sizeof(DailyNetWorth)) != 0) {
+    LOG_ERROR("seg", "Failed to trim %s", path);
+    return;
+  }
+  LOG_WARN("seg", "Dropped %u bytes of a torn append", (unsigned)(size % sizeof(DailyNetWorth)));
+}
+
+// swap a segment's file for one in the other format written to DB_SEGMENT_DIR/<year>.tmp
+static bool replaceSegmentFile(DbSegment& segment, SegmentFormat format) {
+  char tempPath[24];
+  char oldPath[24];
+  char newPath[24];
+  snprintf(tempPath, sizeof(tempPath), DB_SEGMENT_DIR "/%d.tmp", (int)segment.year);
+  getSegmentPath(oldPath, sizeof(oldPath), segment.year, segment.format);
+  getSegmentPath(newPath, sizeof(newPath), segment.year, format);
+
+  if (!LittleFS.rename(tempPath, newPath)) {
+    LittleFS.remove(tempPath);
+    return false;
+  }
+
+  // the directory points at the new file before the old one goes, so a crash in between loses nothing
+  segment.format = format;
+  saveDirectory();
+  LittleFS.remove(oldPath);
+  return true;
+}
+
+// re-encode a sealed raw segment as a compressed series
+// segments holding corrupt or undated records stay raw so record indexes don't move (compaction fixes them)
+static bool compressSegment(DbSegment& segment) {
+  closeCache();
+  char path[24];
+  File source = LittleFS.open(getSegmentPath(path, sizeof(path), segment.year), FILE_READ);
+  snprintf(path, sizeof(path), DB_SEGMENT_DIR "/%d.tmp", (int)segment.year);
+  File target = LittleFS.open(path, FILE_WRITE);
+  if (!source || !target) {
+    return false;
+  }
+
+  SeriesWriter writer(target);
+  DailyNetWorth chunk[DB_READ_CHUNK];
+  size_t rawBytes = source.size();
+  bool ok = true;
+  bool invalid = false;
+  int got;
+  while (ok && (got = source.read((uint8_t*)chunk, sizeof(chunk)) / sizeof(DailyNetWorth)) > 0) {
+    for (int i = 0; i < got && ok; i++) {
+      int32_t day;
+      invalid = !isRecordValid(chunk[i]) || !parseDayNumber(chunk[i].date, day);
+      ok = !invalid && writer.add(day, chunk[i].netWorth);
+    }
+  }
+  ok = ok && writer.finish() && writer.count() == segment.count;
+  size_t seriesBytes = target.size();
+  source.close();
+  target.close();
+
+  if (!ok || !replaceSegmentFile(segment, SegmentFormat::Series)) {
+    LittleFS.remove(path);
+    LOG_WARN("seg", "Left %d uncompressed", (int)segment.year);
+
+    // an invalid record fails the same way every mount, a write failure is worth retrying
+    if (invalid) {
+      segment.keepRaw = true;
+      saveDirectory();
+    }
+    return false;
+  }
+
+  LOG_INFO("seg", "Compressed %d, %u bytes to %u", (int)segment.year, (unsigned)rawBytes, (unsigned)seriesBytes);
+  return true;
+}
+
+// decode a compressed segment back to raw records so it can be updated in place
+static bool expandSegment(DbSegment& segment) {
+  closeCache();
+  char path[24];
+  File source = LittleFS.open(getSegmentPath(path, sizeof(path), segment.year, SegmentFormat::Series), FILE_READ);
+  snprintf(path, sizeof(path), DB_SEGMENT_DIR "/%d.tmp", (int)segment.year);
+  File target = LittleFS.open(path, FILE_WRITE);
+  if (!source || !target) {
+    return false;
+  }
+
+  DailyNetWorth chunk[DB_READ_CHUNK];
+  int expanded = 0;
+  bool ok = true;
+  int got;
+  while (ok && expanded < segment.count && (got = readSeries(source, expanded, chunk, DB_READ_CHUNK)) > 0) {
+    ok = target.write((uint8_t*)chunk, got * sizeof(DailyNetWorth)) == got * sizeof(DailyNetWorth);
+    expanded += got;
+  }
+  source.close();
+  target.close();
+
+  if (!ok || expanded != segment.count || !replaceSegmentFile(segment, SegmentFormat::Raw)) {
+    LittleFS.remove(path);
+    LOG_ERROR("seg", "Failed to expand %d", (int)segment.year);
+    return false;
+  }
+  return true;
+}
+
+// compress every sealed segment still holding raw records
+static void compressSealed() {
+#if DB_COMPRESS_SEALED
+  for (int i = 0; i < segmentCount - 1; i++) {
+    if (segments[i].format == SegmentFormat::Raw && !segments[i].keepRaw) {
+      compressSegment(segments[i]);
+    }
+  }
+#endif
+}
+
+// recreate the directory from the segment files themselves
+static bool rebuildDirectory() {
+  closeCache();
+  segmentCount = 0;
+
+  File root = LittleFS.open(DB_SEGMENT_DIR);
+  if (root && root.isDirectory()) {
+    File entry;
+    while ((entry = root.openNextFile())) {
+      // names are "<year>.dat" or "<year>.nws", anything else (the directory itself, temporary files) is skipped
+      const char* name = strrchr(entry.name(), '/');
+      name = name ? name + 1 : entry.name();
+      int year;
+      char suffix[5] = "";
+      bool named = sscanf(name, "%d.%4s", &year, suffix) == 2;
+      entry.close();
+
+      SegmentFormat format = strcmp(suffix, "nws") == 0 ? SegmentFormat::Series : SegmentFormat::Raw;
+      if (!named || (format == SegmentFormat::Raw && strcmp(suffix, "dat") != 0)) {
+        continue;
+      }
+
+      DbSegment segment = { year, 0, 0, 0, format, 0, false };
+      if (!scanSegment(segment)) {
+        continue;
+      }
+
+      // keep the list sorted by year, a compression interrupted before the raw file was removed leaves both
+      int position = 0;
+      while (position < segmentCount && segments[position].year < year) {
+        position++;
+      }
+      if (position < segmentCount && segments[position].year == year) {
+        if (format == SegmentFormat::Raw) {
+          segments[position] = segment;
+        }
+        continue;
+      }
+      if (segmentCount >= DB_MAX_SEGMENTS) {
+        continue;
+      }
+      memmove(segments + position + 1, segments + position, (segmentCount - position) * sizeof(DbSegment));
+      segments[position] = segment;
+      segmentCount++;
+    }
+    root.close();
+  }
+
+  updateIndexes();
+  if (segmentCount > 0) {
+    trimPartialRecord(segments[segmentCount - 1]);
+  }
+  LOG_INFO("seg", "Rebuilt segment directory, %d segments", segmentCount);
+  bool saved = saveDirectory();
+  compressSealed();
+  return saved;
+}
+
+bool initSegments() {
+  closeCache();
+  LittleFS.mkdir(DB_SEGMENT_DIR);
+
+  DbDirectoryHeader header;
+  File file = LittleFS.open(DB_DIRECTORY_FILE, FILE_READ);
+  bool ok = file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header);
+  ok = ok && header.magic == DB_DIRECTORY_MAGIC && header.count <= DB_MAX_SEGMENTS;
+  ok = ok && file.read((uint8_t*)segments, header.count * sizeof(DbSegment)) == header.count * sizeof(DbSegment);
+  ok = ok && header.crc == esp_rom_crc32_le(0, (const uint8_t*)segments, header.count * sizeof(DbSegment));
+  if (file) {
+    file.close();
+  }
+
+  if (!ok) {
+    return rebuildDirectory();
+  }
+  segmentCount = header.count;
+
+  // the current segment grows without directory writes, so its count and last day come from the file
+  if (segmentCount > 0 && !scanSegment(segments[segmentCount - 1])) {
+    segmentCount--; // created but never written
+    saveDirectory();
+  }
+  if (segmentCount > 0) {
+    trimPartialRecord(segments[segmentCount - 1]);
+  }
+
+  // sealed years left raw by an upgrade, an in-place update or an interrupted compression
+  updateIndexes();
+  compressSealed();
+  return true;
+}
+
+int getSegmentRecordCount() {
+  return segmentCount > 0 ? segments[segmentCount - 1].firstIndex + segments[segmentCount - 1].count : 0;
+}
+
+int getSegmentCount() {
+  return segmentCount;
+}
+
+const DbSegment& getSegment(int segment) {
+  return segments[segment];
+}
+
+int findSegmentByIndex(int index) {
+  int low = 0;
+  int high = segmentCount - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (index < segments[mid].firstIndex) {
+      high = mid - 1;
+    } else if (index >= segments[mid].firstIndex + segments[mid].count) {
+      low = mid + 1;
+    } else {
+      return mid;
+    }
+  }
+  return -1;
+}
+
+int findSegmentByDay(int32_t dayNumber) {
+  int low = 0;
+  int high = segmentCount;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (segments[mid].lastDay < dayNumber) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static File& openSegment(const DbSegment& segment) {
+  if (cachedYear != segment.year) {
+    closeCache();
+    char path[24];
+    cachedFile = LittleFS.open(getSegmentPath(path, sizeof(path), segment.year, segment.format), FILE_READ);
+    cachedYear = cachedFile ? segment.year : -1;
+  }
+  return cachedFile;
+}
+
+int readSegmentRecords(int index, DailyNetWorth* buffer, int count) {
+  int read = 0;
+  int segment = findSegmentByIndex(index);
+
+  while (segment >= 0 && segment < segmentCount && read < count) {
+    const DbSegment& current = segments[segment];
+    int local = index + read - current.firstIndex;
+    int want = min(count - read, current.count - local);
+
+    File& file = openSegment(current);
+    if (!file) {
+      break;
+    }
+
+    int got;
+    if (current.format == SegmentFormat::Series) {
+      got = readSeries(file, local, buffer + read, want);
+    } else {
+      file.seek(local * sizeof(DailyNetWorth));
+      got = file.read((uint8_t*)(buffer + read), want * sizeof(DailyNetWorth)) / sizeof(DailyNetWorth);
+    }
+    read += got;
+    if (got < want) {
+      break;
+    }
+    segment++;
+  }
+
+  return read;
+}
+
+bool writeSegmentRecord(int index, const DailyNetWorth& record) {
+  int segment = findSegmentByIndex(index);
+  if (segment < 0 || (segments[segment].format == SegmentFormat::Series && !expandSegment(segments[segment]))) {
+    return false;
+  }
+
+  closeCache();
+  char path[24];
+  File file = LittleFS.open(getSegmentPath(path, sizeof(path), segments[segment].year), "r+");
+  if (!file) {
+    return false;
+  }
+
+  file.seek((index - segments[segment].firstIndex) * sizeof(DailyNetWorth));
+  size_t written = file.write((uint8_t*)&record, sizeof(DailyNetWorth));
+  file.close();
+
+  // the write may have replaced the record that kept the year raw, the next mount tries again
+  if (segments[segment].keepRaw) {
+    segments[segment].keepRaw = false;
+    saveDirectory();
+  }
+  return written == sizeof(DailyNetWorth);
+}
+
+bool appendSegmentRecord(const DailyNetWorth& record, int32_t dayNumber) {
+  if (getSegmentRecordCount() > 0 && dayNumber <= segments[segmentCount - 1].lastDay) {
+    LOG_ERROR("seg", "Refusing to append %s out of date order", record.date);
+    return false;
+  }
+  int32_t year = yearOf(dayNumber);
+
+  // a new year seals the current segment, the directory is written before the first record goes in
+  if (segmentCount == 0 || year > segments[segmentCount - 1].year) {
+    if (segmentCount >= DB_MAX_SEGMENTS) {
+      LOG_ERROR("seg", "Segment directory is full");
+      return false;
+    }
+    segments[segmentCount] = { year, dayNumber, dayNumber, 0, SegmentFormat::Raw, getSegmentRecordCount(), false };
+    segmentCount++;
+    if (!saveDirectory()) {
+      segmentCount--;
+      return false;
+    }
+    compressSealed();
+  }
+
+  // the current year only ends up compressed if the years after it were dropped
+  DbSegment& current = segments[segmentCount - 1];
+  if (current.format == SegmentFormat::Series && !expandSegment(current)) {
+    return false;
+  }
+  closeCache();
+  char path[24];
+  File file = LittleFS.open(getSegmentPath(path, sizeof(path), current.year), FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+
+  size_t written = file.write((uint8_t*)&record, sizeof(DailyNetWorth));
+  file.close();
+  if (written != sizeof(DailyNetWorth)) {
+    return false;
+  }
+
+  if (current.count == 0) {
+    current.firstDay = dayNumber;
+  }
+  current.count++;
+  current.lastDay = max(current.lastDay, dayNumber);
+  return true;
+}
+
+bool truncateSegments(int count) {
+  closeCache();
+  bool ok = true;
+
+  while (segmentCount > 0 && getSegmentRecordCount() > count) {
+    DbSegment& last = segments[segmentCount - 1];
+    int keep = max(0, count - last.firstIndex);
+    if (keep > 0 && last.format == SegmentFormat::Series && !expandSegment(last)) {
+      return false;
+    }
+
+    char path[24];
+    getSegmentPath(path, sizeof(path), last.year, last.format);
+    if (keep == 0) {
+      LittleFS.remove(path);
+      segmentCount--;
+      ok = saveDirectory() && ok;
+      continue;
+    }
+
+    char fullPath[32];
+    snprintf(fullPath, sizeof(fullPath), DB_MOUNT_POINT "%s", path);
+    if (truncate(fullPath, keep * sizeof(DailyNetWorth)) != 0) {
+      return false;
+    }
+    ok = scanSegment(last) && ok;
+  }
+
+  return ok;
+}
+
+int rewriteSegments(const std::function<int(DailyNetWorth* chunk, int maxRecords)>& source) {
+  closeCache();
+
+  int32_t years[DB_MAX_SEGMENTS];
+  int yearCount = 0;
+  File target;
+  char path[24];
+  DailyNetWorth chunk[DB_READ_CHUNK];
+  int written = 0;
+  bool ok = true;
+  int got;
+
+  while (ok && (got = source(chunk, DB_READ_CHUNK)) > 0) {
+    // write each run of same-year records in one call
+    int start = 0;
+    while (ok && start < got) {
+      int32_t day;
+      if (!parseDayNumber(chunk[start].date, day)) {
+        start++;
+        continue;
+      }
+
+      int32_t year = yearOf(day);
+      if (yearCount == 0 || years[yearCount - 1] != year) {
+        if (target) {
+          target.close();
+        }
+        if (yearCount >= DB_MAX_SEGMENTS || (yearCount > 0 && year < years[yearCount - 1])) {
+          ok = false;
+          break;
+        }
+        years[yearCount++] = year;
+        snprintf(path, sizeof(path), DB_SEGMENT_DIR "/%d.tmp", (int)year);
+        target = LittleFS.open(path, FILE_WRITE);
+        ok = target;
+      }
+
+      int end = start + 1;
+      int32_t next;
+      while (end < got && parseDayNumber(chunk[end].date, next) && yearOf(next) == year) {
+        end++;
+      }
+
+      size_t bytes = (end - start) * sizeof(DailyNetWorth);
+      ok = ok && target.write((uint8_t*)(chunk + start), bytes) == bytes;
+      written += end - start;
+      start = end;
+    }
+  }
+  if (target) {
+    target.close();
+  }
+
+  if (!ok) {
+    for (int i = 0; i < yearCount; i++) {
+      snprintf(path, sizeof(path), DB_SEGMENT_DIR "/%d.tmp", (int)years[i]);
+      LittleFS.remove(path);
+    }
+    LOG_ERROR("seg", "Failed to rewrite segments");
+    return -1;
+  }
+
+  // swap the new files in, then drop segments for years that no longer have records
+  // the directory goes first: a crash part way through leaves none, and the next mount rebuilds it from the files
+  // (preferring the new raw file where a year still has its old compressed one) instead of trusting stale entries
+  closeCache();
+  LittleFS.remove(DB_DIRECTORY_FILE);
+  for (int i = 0; i < yearCount; i++) {
+    char finalPath[24];
+    snprintf(path, sizeof(path), DB_SEGMENT_DIR "/%d.tmp", (int)years[i]);
+    LittleFS.rename(path, getSegmentPath(finalPath, sizeof(finalPath), years[i]));
+  }
+  for (int i = 0; i < segmentCount; i++) {
+    bool kept = false;
+    for (int y = 0; y < yearCount && !kept; y++) {
+      kept = years[y] == segments[i].year;
+    }
+    // a kept year was written raw, so only its compressed file is stale
+    if (!kept || segments[i].format == SegmentFormat::Series) {
+      LittleFS.remove(getSegmentPath(path, sizeof(path), segments[i].year, segments[i].format));
+    }
+  }
+
+  segmentCount = 0;
+  for (int i = 0; i < yearCount; i++) {
+    DbSegment segment = { years[i], 0, 0, 0, SegmentFormat::Raw, 0, false };
+    if (scanSegment(segment)) {
+      segments[segmentCount++] = segment;
+    }
+  }
+  updateIndexes();
+  saveDirectory();
+  compressSealed();
+  return written;
+}
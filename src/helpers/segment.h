@@ -0,0 +1,77 @@
+#ifndef HELPERS_SEGMENT_H
+#define HELPERS_SEGMENT_H
+
+#include <Arduino.h>
+#include <functional>
+#include "database.h"
+
+#define DB_SEGMENT_DIR "/nw"
+#define DB_DIRECTORY_FILE DB_SEGMENT_DIR "/dir.dat"
+#define DB_DIRECTORY_MAGIC 0x32524457 // "WDR2"
+#define DB_MAX_SEGMENTS 64 // calendar years of history
+
+// re-encode sealed years as compressed series (see series.h), set to 0 to keep every year as raw records
+#ifndef DB_COMPRESS_SEALED
+  #define DB_COMPRESS_SEALED 1
+#endif
+
+enum class SegmentFormat : int32_t {
+  Raw, // DailyNetWorth records, <year>.dat
+  Series // compressed blocks, <year>.nws
+};
+
+/*
+  daily records are split into one file per calendar year (DB_SEGMENT_DIR/<year>.dat), in date order
+  every segment but the last is sealed, so appends only touch the current year and the directory
+  is only rewritten when a segment is created or the store is rewritten
+  sealed years are compressed when the next one starts (and at mount), an in-place update of
+  one expands it back to raw records until the next mount
+*/
+struct DbSegment {
+  int32_t year;
+  int32_t firstDay; // day number of the first record
+  int32_t lastDay; // day number of the last record
+  int32_t count; // records in the segment
+  SegmentFormat format;
+  int32_t firstIndex; // index of the first record across all segments (not stored, derived on load)
+  bool keepRaw; // holds an invalid record, so compression is skipped until the year is written again
+};
+
+// load the directory, refreshing the current segment from its file, or rebuild it from the segment files
+bool initSegments();
+
+// total records across all segments
+int getSegmentRecordCount();
+
+// number of segments and one segment's entry, oldest first
+int getSegmentCount();
+const DbSegment& getSegment(int segment);
+
+// "/nw/<year>.dat" or "/nw/<year>.nws"
+const char* getSegmentPath(char* buffer, size_t size, int32_t year, SegmentFormat format = SegmentFormat::Raw);
+
+// segment holding a record index, or -1
+int findSegmentByIndex(int index);
+
+// first segment whose last day is on or after dayNumber (getSegmentCount() if none), a binary search
+int findSegmentByDay(int32_t dayNumber);
+
+// read up to count records starting at index, crossing segments as needed, returns the number read
+int readSegmentRecords(int index, DailyNetWorth* buffer, int count);
+
+// overwrite a stored record in place
+bool writeSegmentRecord(int index, const DailyNetWorth& record);
+
+// append a record to the current segment, or start a new one when its year is later
+// a day not after the last stored one is refused, records stay in date order for the binary searches
+bool appendSegmentRecord(const DailyNetWorth& record, int32_t dayNumber);
+
+// drop records from the end until count remain
+bool truncateSegments(int count);
+
+// replace every segment with the records from source (ascending dates, one chunk per call, 0 when done)
+// each year is written to a temporary file and renamed over its segment once all are written
+// returns the number of records written or -1 on failure
+int rewriteSegments(const std::function<int(DailyNetWorth* chunk, int maxRecords)>& source);
+
+#endif
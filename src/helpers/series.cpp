@@ -0,0 +1,179 @@
+#include "series.h"
+#include "calendar.h"
+#include <esp_rom_crc.h>
+
+static uint64_t zigzag(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static int putVarint(uint8_t* out, uint64_t value) {
+  int length = 0;
+  while (value >= 0x80) {
+    out[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+static bool getVarint(const uint8_t* in, int& position, int end, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; position < end && shift < 64; shift += 7) {
+    uint8_t byte = in[position++];
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// a header whose count can't fit its payload (every sample after the first takes a byte or more) would
+// misplace every later sample, the file is treated as ending before it
+static bool isHeaderUsable(const SeriesBlockHeader& header) {
+  return header.count > 0 && header.used <= SERIES_PAYLOAD_SIZE && header.count <= header.used + 1;
+}
+
+static uint32_t blockCrc(const SeriesBlockHeader& header, const uint8_t* payload) {
+  uint32_t crc = esp_rom_crc32_le(0, (const uint8_t*)&header, offsetof(SeriesBlockHeader, crc));
+  return esp_rom_crc32_le(crc, payload, header.used);
+}
+
+bool SeriesWriter::add(int32_t dayNumber, int32_t value) {
+  if (open) {
+    // value deltas can exceed 32 bits between extremes, so the sample is built as 64 bit varints
+    int32_t step = dayNumber - lastDay;
+    int64_t stepChange = (int64_t)step - lastStep;
+    uint8_t sample[20];
+    int length = putVarint(sample, (zigzag((int64_t)value - lastValue) << 1) | (stepChange != 0));
+    if (stepChange != 0) {
+      length += putVarint(sample + length, zigzag(stepChange));
+    }
+
+    if ((size_t)(header.used + length) <= SERIES_PAYLOAD_SIZE && header.count < UINT16_MAX) {
+      memcpy(payload + header.used, sample, length);
+      header.used += length;
+      header.count++;
+      lastStep = step;
+      lastDay = dayNumber;
+      lastValue = value;
+      total++;
+      return true;
+    }
+
+    if (!flush()) {
+      return false;
+    }
+  }
+
+  // first sample of a block is stored whole, with a daily step assumed after it
+  header = { dayNumber, value, 1, 0, 0 };
+  lastDay = dayNumber;
+  lastStep = 1;
+  lastValue = value;
+  open = true;
+  total++;
+  return true;
+}
+
+bool SeriesWriter::flush() {
+  header.crc = blockCrc(header, payload);
+  memset(payload + header.used, 0, SERIES_PAYLOAD_SIZE - header.used);
+  open = false;
+
+  bool ok = file.write((uint8_t*)&header, sizeof(header)) == sizeof(header);
+  return ok && file.write(payload, SERIES_PAYLOAD_SIZE) == SERIES_PAYLOAD_SIZE;
+}
+
+bool SeriesWriter::finish() {
+  return !open || flush();
+}
+
+static void makeSample(DailyNetWorth& record, int32_t dayNumber, int32_t value, bool valid) {
+  memset(&record, 0, sizeof(DailyNetWorth));
+  formatDayNumber(record.date, DATE_LEN, dayNumber);
+  record.netWorth = value;
+  record.crc = esp_rom_crc32_le(0, (const uint8_t*)&record, offsetof(DailyNetWorth, crc)) ^ (valid ? 0 : 1);
+}
+
+// decode samples [skip, skip + maxRecords) of one block, returns the number decoded
+static int decodeBlock(const SeriesBlockHeader& header, const uint8_t* payload, int skip, DailyNetWorth* records, int maxRecords) {
+  bool valid = header.used <= SERIES_PAYLOAD_SIZE && header.crc == blockCrc(header, payload);
+  int32_t day = header.firstDay;
+  int32_t step = 1;
+  int64_t value = header.firstValue;
+  int position = 0;
+  int decoded = 0;
+
+  for (int i = 0; i < header.count && decoded < maxRecords; i++) {
+    if (i > 0 && valid) {
+      uint64_t sample;
+      uint64_t stepChange = 0;
+      valid = getVarint(payload, position, header.used, sample) && (!(sample & 1) || getVarint(payload, position, header.used, stepChange));
+      step += (int32_t)unzigzag(stepChange);
+      day += step;
+      value += unzigzag(sample >> 1);
+    }
+    if (i >= skip) {
+      makeSample(records[decoded++], day, (int32_t)value, valid);
+    }
+  }
+  return decoded;
+}
+
+int readSeries(File& file, int first, DailyNetWorth* records, int maxRecords) {
+  int blocks = file.size() / SERIES_BLOCK_SIZE;
+  SeriesBlockHeader header;
+  uint8_t payload[SERIES_PAYLOAD_SIZE];
+  int blockFirst = 0;
+  int decoded = 0;
+
+  for (int block = 0; block < blocks && decoded < maxRecords; block++) {
+    file.seek(block * SERIES_BLOCK_SIZE);
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || !isHeaderUsable(header)) {
+      break;
+    }
+
+    // blocks ending before the first wanted sample are skipped without reading their payload
+    int start = first + decoded - blockFirst;
+    blockFirst += header.count;
+    if (start >= header.count) {
+      continue;
+    }
+
+    if (file.read(payload, SERIES_PAYLOAD_SIZE) != SERIES_PAYLOAD_SIZE) {
+      break;
+    }
+    decoded += decodeBlock(header, payload, start, records + decoded, maxRecords - decoded);
+  }
+
+  return decoded;
+}
+
+bool scanSeries(File& file, int& count, int32_t& firstDay, int32_t& lastDay) {
+  int blocks = file.size() / SERIES_BLOCK_SIZE;
+  SeriesBlockHeader header;
+  count = 0;
+
+  for (int block = 0; block < blocks; block++) {
+    file.seek(block * SERIES_BLOCK_SIZE);
+    if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+      return false;
+    }
+    if (!isHeaderUsable(header)) {
+      break;
+    }
+    if (block == 0) {
+      firstDay = header.firstDay;
+    }
+    count += header.count;
+  }
+
+  // the last day is only known by decoding the last block
+  DailyNetWorth last;
+  return count > 0 && readSeries(file, count - 1, &last, 1) == 1 && isRecordValid(last) && parseDayNumber(last.date, lastDay);
+}
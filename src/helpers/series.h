@@ -0,0 +1,62 @@
+#ifndef HELPERS_SERIES_H
+#define HELPERS_SERIES_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "database.h"
+
+#define SERIES_BLOCK_SIZE 128 // bytes per block on flash, header included
+#define SERIES_PAYLOAD_SIZE (SERIES_BLOCK_SIZE - sizeof(SeriesBlockHeader))
+
+/*
+  compressed daily series, a run of fixed size blocks each starting from a full (day, value) sample
+  the samples after it are one varint each: the zig-zag value delta shifted left one bit, the low bit
+  set when the day step changed (delta-of-delta, followed by its own zig-zag varint), so a daily
+  record with a four figure change takes 2 bytes instead of sizeof(DailyNetWorth)
+*/
+struct SeriesBlockHeader {
+  int32_t firstDay; // day number of the first sample
+  int32_t firstValue;
+  uint16_t count; // samples in the block, the first one included
+  uint16_t used; // payload bytes after the header
+  uint32_t crc; // crc32 of the fields above and the used payload
+};
+
+// appends samples to a series file, a block is written out each time one fills up
+class SeriesWriter {
+ public:
+  explicit SeriesWriter(File& file) : file(file) {}
+
+  // add the next sample, returns false if a block failed to write
+  bool add(int32_t dayNumber, int32_t value);
+
+  // write out the partial last block
+  bool finish();
+
+  // samples added so far
+  int count() const { return total; }
+
+ private:
+  bool flush();
+
+  File& file;
+  SeriesBlockHeader header;
+  uint8_t payload[SERIES_PAYLOAD_SIZE];
+  int32_t lastDay = 0;
+  int32_t lastStep = 0;
+  int32_t lastValue = 0;
+  int total = 0;
+  bool open = false;
+};
+
+// decode up to maxRecords samples starting at sample index first into records (crcs included)
+// whole blocks before first are skipped by their header, samples of a corrupt block come out failing their crc
+// and reading stops at a header whose count is impossible
+// returns the number of records decoded
+int readSeries(File& file, int first, DailyNetWorth* records, int maxRecords);
+
+// sample count and day range of a series file, reading only the headers and the last block
+// (counted up to the same unusable header readSeries stops at)
+bool scanSeries(File& file, int& count, int32_t& firstDay, int32_t& lastDay);
+
+#endif
@@ -0,0 +1,41 @@
+#include "sparkline.h"
+
+void SparklineReducer::begin(int totalValues, int width) {
+  total = totalValues;
+  columns = constrain(min(totalValues, width), 0, SPARKLINE_MAX_COLUMNS);
+  added = 0;
+  bucketCount = 0;
+}
+
+void SparklineReducer::add(int32_t value) {
+  addRange(value, value, value);
+}
+
+void SparklineReducer::addRange(int32_t low, int32_t high, int32_t last) {
+  if (added >= total || columns == 0) {
+    return;
+  }
+
+  if (added == 0) {
+    firstValue = last;
+    minValue = low;
+    maxValue = high;
+  }
+  minValue = std::min(minValue, low);
+  maxValue = std::max(maxValue, high);
+
+  // values map evenly onto columns, a new column starts a new bucket
+  int column = (int)((int64_t)added * columns / total);
+  added++;
+
+  if (column >= bucketCount) {
+    bucketCount = column + 1;
+    buckets[column] = { low, high, last };
+    return;
+  }
+
+  SparkBucket& bucket = buckets[column];
+  bucket.min = std::min(bucket.min, low);
+  bucket.max = std::max(bucket.max, high);
+  bucket.last = last;
+}
@@ -0,0 +1,47 @@
+#ifndef HELPERS_SPARKLINE_H
+#define HELPERS_SPARKLINE_H
+
+#include <Arduino.h>
+
+#define SPARKLINE_MAX_COLUMNS 240 // one bucket per pixel column of the widest sparkline
+
+// range of values that landed in one pixel column
+struct SparkBucket {
+  int32_t min;
+  int32_t max;
+  int32_t last;
+};
+
+/*
+  reduces a stream of values (oldest first) into at most one bucket per pixel column,
+  so memory and draw cost depend on the sparkline width instead of the history length
+*/
+class SparklineReducer {
+ public:
+  // prepare for `total` values drawn across `columns` pixels
+  void begin(int total, int columns);
+
+  // add the next value, must be called exactly `total` times (together with addRange)
+  void add(int32_t value);
+
+  // add the next slot as an already aggregated range (e.g. a weekly rollup)
+  void addRange(int32_t low, int32_t high, int32_t last);
+
+  int count() const { return bucketCount; }
+  const SparkBucket& bucket(int i) const { return buckets[i]; }
+  int32_t first() const { return firstValue; }
+  int32_t lowest() const { return minValue; }
+  int32_t highest() const { return maxValue; }
+
+ private:
+  SparkBucket buckets[SPARKLINE_MAX_COLUMNS];
+  int total = 0;
+  int columns = 0;
+  int added = 0;
+  int bucketCount = 0;
+  int32_t firstValue = 0;
+  int32_t minValue = 0;
+  int32_t maxValue = 0;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "transport.h"
+#include "log.h"
+#ifndef API_FIXTURES
+  #include "httptransport.h"
+#endif
+
+int FixtureTransport::get(const FetchRequest& request, uint32_t connectTimeoutMs, uint32_t readTimeoutMs) {
+  if (connectMs > connectTimeoutMs) {
+    delay(connectTimeoutMs);
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  if (responseMs > readTimeoutMs) {
+    delay(connectMs + readTimeoutMs);
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+  delay(connectMs + responseMs);
+
+  char path[32];
+  snprintf(path, sizeof(path), FIXTURE_DIR "/%s.json", getEndpointName(request.endpoint));
+
+  file = LittleFS.open(path, FILE_READ);
+  if (!file) {
+    LOG_WARN("fixture", "Missing fixture %s", path);
+    return 404;
+  }
+
+  return HTTP_CODE_OK;
+}
+
+Stream& FixtureTransport::body() {
+  return file;
+}
+
+uint32_t FixtureTransport::retryAfterMs() {
+  return 0;
+}
+
+void FixtureTransport::end() {
+  if (file) {
+    file.close();
+  }
+}
+
+#ifdef API_FIXTURES
+static FixtureTransport defaultTransport;
+#else
+static HttpTransport defaultTransport;
+#endif
+
+static Transport* activeTransport = &defaultTransport;
+
+Transport& getTransport() {
+  return *activeTransport;
+}
+
+void setTransport(Transport* transport) {
+  activeTransport = transport ? transport : &defaultTransport;
+}
@@ -0,0 +1,56 @@
+#ifndef HELPERS_TRANSPORT_H
+#define HELPERS_TRANSPORT_H
+
+#include <Arduino.h>
+#include <HTTPClient.h> // HTTP codes
+#include <LittleFS.h>
+#include "fetch.h"
+
+#define FIXTURE_DIR "/fixtures"
+
+// a single GET exchange, the fetch executor owns retries and deadlines
+class Transport {
+ public:
+  virtual ~Transport() {}
+
+  // issue the request, returns the HTTP code (negative for transport errors)
+  virtual int get(const FetchRequest& request, uint32_t connectTimeoutMs, uint32_t readTimeoutMs) = 0;
+
+  // response body of the last request, valid until end()
+  virtual Stream& body() = 0;
+
+  // Retry-After of the last response in ms (0 if not sent)
+  virtual uint32_t retryAfterMs() = 0;
+
+  // release the connection or file
+  virtual void end() = 0;
+};
+
+// serves recorded payloads from FIXTURE_DIR/<endpoint>.json on LittleFS instead of the network
+// with a simulated latency, a slow "server" times out against the attempt's timeouts like a real one
+class FixtureTransport : public Transport {
+ public:
+  int get(const FetchRequest& request, uint32_t connectTimeoutMs, uint32_t readTimeoutMs) override;
+  Stream& body() override;
+  uint32_t retryAfterMs() override;
+  void end() override;
+
+  // time to connect and until the response starts, 0 (the default) answers at once
+  void setLatency(uint32_t connect, uint32_t response) {
+    connectMs = connect;
+    responseMs = response;
+  }
+
+ private:
+  File file;
+  uint32_t connectMs = 0;
+  uint32_t responseMs = 0;
+};
+
+// transport used by the fetch executor (HttpTransport unless built with -DAPI_FIXTURES)
+Transport& getTransport();
+
+// swap the transport, e.g. to replay fixtures
+void setTransport(Transport* transport);
+
+#endif
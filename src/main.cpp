@@ -14,6 +14,17 @@
 #include "helpers/power.h"
 #include "helpers/api.h"
 #include "helpers/database.h"
+#include "helpers/rollup.h"
+#include "helpers/intraday.h"
+#include "helpers/changes.h"
+#include "helpers/dbmeta.h"
+#include "helpers/accounts.h"
+#include "helpers/backfill.h"
+#include "helpers/log.h"
+#include "helpers/fetch.h"
+#include "helpers/arena.h"
+#include "helpers/heapguard.h"
+#include "helpers/profile.h"
 #include "credentials.h"
 #include "configuration.h"
 #include "icons/no_wifi.h"
@@ -40,80 +51,159 @@ RTC_DATA_ATTR bool initialized = false;
 RTC_DATA_ATTR char goldPrice[16] = "N/A";
 RTC_DATA_ATTR char bitcoinPrice[16] = "N/A";
 RTC_DATA_ATTR float percentChange = 0.0f;
+RTC_DATA_ATTR int percentChangeDays = 1; // days the change covers, more than 1 if the device missed days
 
 bool wifiConnected = false;
 
 bool connectWiFi() {
-  Serial.print("Connecting to WiFi...");
+  LOG_INFO("wifi", "Connecting to WiFi...");
   WiFi.mode(WIFI_STA);
   WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
 
   int attempts = 0;
   while (WiFi.status() != WL_CONNECTED && attempts < 20) {
     delay(500);
-    Serial.print(".");
     attempts++;
   }
 
   if (WiFi.status() == WL_CONNECTED) {
-    Serial.println(" Connected!");
-    Serial.println("IP address: " + WiFi.localIP().toString());
+    IPAddress ip = WiFi.localIP();
+    LOG_INFO("wifi", "Connected after %d attempts, IP address: %u.%u.%u.%u", attempts, ip[0], ip[1], ip[2], ip[3]);
     return true;
   } else {
-    Serial.println(" Failed!");
+    LOG_WARN("wifi", "Connection failed after %d attempts", attempts);
     return false;
   }
 }
 
-void syncTime() {
-  Serial.print("Syncing time with NTP...");
+bool syncTime() {
+  LOG_INFO("ntp", "Syncing time with NTP...");
   configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);
 
   // wait for time to sync (up to 10 seconds)
   struct tm timeinfo;
   int attempts = 0;
   while (!getLocalTime(&timeinfo, 1000) && attempts < 10) {
-    Serial.print(".");
     attempts++;
   }
 
   if (getLocalTime(&timeinfo, 100)) {
-    Serial.println(" Time synced!");
-    Serial.printf("Current time: %02d:%02d:%02d\n", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+    LOG_INFO("ntp", "Time synced, current time: %02d:%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+    return true;
   } else {
-    Serial.println(" Time sync failed!");
+    LOG_WARN("ntp", "Time sync failed!");
+    return false;
   }
 }
 
 void disconnectWiFi() {
   WiFi.disconnect(true);
   WiFi.mode(WIFI_OFF);
-  Serial.println("WiFi disconnected");
+  LOG_DEBUG("wifi", "WiFi disconnected");
 }
 
 void updateScreen() {
-  Serial.println("Refreshing screen...");
+  LOG_INFO("main", "Refreshing screen...");
 
   display.setRotation(0);
 
+  // build every string up front into stack buffers, the page loop below runs once per display page
+  char ownerText[32];
+  char headerText[48];
+  snprintf(headerText, sizeof(headerText), "%s Net Worth", formatPossessive(ownerText, sizeof(ownerText), OWNER_NAME));
+
+  char goldText[32];
+  char btcText[32];
+  snprintf(goldText, sizeof(goldText), "Gold: %s", goldPrice);
+  snprintf(btcText, sizeof(btcText), "Bitcoin: %s", bitcoinPrice);
+
+  char netWorthStr[CURRENCY_LEN] = "N/A";
+  if (netWorth > 0) {
+    formatCurrency(netWorthStr, sizeof(netWorthStr), netWorth);
+  }
+
+  char percentStr[PERCENT_LEN];
+  char percentText[40];
+  formatPercentage(percentStr, sizeof(percentStr), percentChange);
+  if (percentChangeDays > 1) {
+    snprintf(percentText, sizeof(percentText), "%s last %d days", percentStr, percentChangeDays);
+  } else {
+    snprintf(percentText, sizeof(percentText), "%s last 24 hours", percentStr);
+  }
+
+  char goalProjection[48];
+  bool hasGoalProjection = getGoalProjection(goalProjection, sizeof(goalProjection));
+
+  // risk line below the projection, from the statistics kept in the database header (no record reads)
+  char riskText[64];
+  RiskSummary risk;
+  bool hasRisk = getRiskSummary(getDbMeta().risk, risk);
+  if (hasRisk) {
+    char volatilityStr[PERCENT_LEN];
+    char drawdownStr[PERCENT_LEN];
+    formatPercentage(volatilityStr, sizeof(volatilityStr), risk.volatility * 100.0f);
+    formatPercentage(drawdownStr, sizeof(drawdownStr), risk.maxDrawdown * 100.0f);
+    int length = snprintf(riskText, sizeof(riskText), "Volatility %s   Max drawdown %s", volatilityStr, drawdownStr);
+    if (risk.hasCagr) {
+      char cagrStr[PERCENT_LEN];
+      formatPercentage(cagrStr, sizeof(cagrStr), risk.cagr * 100.0f);
+      snprintf(riskText + length, sizeof(riskText) - length, "   CAGR %s%s", risk.cagr < 0 ? "-" : "", cagrStr);
+    }
+  }
+
+  // longer term changes for the panel beside the sparkline, all from one pass over the tail of the history
+  static const ChangeWindow panelWindows[] = { ChangeWindow::Week, ChangeWindow::Month, ChangeWindow::YearToDate, ChangeWindow::Year };
+  const int panelCount = sizeof(panelWindows) / sizeof(panelWindows[0]);
+  WindowChange panel[panelCount];
+  bool hasPanel = computeChanges(panelWindows, panelCount, panel) > 0;
+
+  char panelText[panelCount][PERCENT_LEN + 1];
+  for (int i = 0; i < panelCount; i++) {
+    char panelPercent[PERCENT_LEN];
+    if (panel[i].valid) {
+      snprintf(panelText[i], sizeof(panelText[i]), "%c%s", panel[i].change < 0 ? '-' : '+', formatPercentage(panelPercent, sizeof(panelPercent), panel[i].percent));
+    } else {
+      snprintf(panelText[i], sizeof(panelText[i]), "--");
+    }
+  }
+
+  char timeStr[TIME_LEN];
+  getFormattedTime(timeStr, sizeof(timeStr));
+
   // calculate header banner dimensions
-  String headerText = formatPossessive(OWNER_NAME) + " Net Worth";
   const int headerPadding = 20;
   display.setFont(&FreeSansBold24pt7b);
   int16_t x1, y1;
   uint16_t textW, textH;
-  display.getTextBounds(headerText.c_str(), 0, 0, &x1, &y1, &textW, &textH);
+  display.getTextBounds(headerText, 0, 0, &x1, &y1, &textW, &textH);
   int bannerHeight = textH + (headerPadding * 2);
   bool lowBattery = isBatteryLow();
 
-  // get sparkline historical data
-  DailyNetWorth historyBuffer[SPARKLINE_DAYS];
-  int historyCount = getNetWorthHistory(historyBuffer, SPARKLINE_DAYS);
-  int32_t sparklineValues[SPARKLINE_DAYS];
-  for (int i = 0; i < historyCount; i++) {
-    sparklineValues[i] = historyBuffer[i].netWorth;
+  // stream sparkline history from flash, reduced to one bucket per pixel column
+  const int sparklineWidth = 240;
+  static SparklineReducer sparkline;
+  int historyCount = min(SPARKLINE_DAYS, getRecordCount());
+
+  if (SPARKLINE_DAYS > sparklineWidth * 4) {
+    // long ranges read weekly rollups instead of thousands of daily records, and monthly ones once even
+    // the weeks would be more than 4 per pixel column
+    bool monthly = SPARKLINE_DAYS > sparklineWidth * 4 * 7;
+    RollupTier tier = monthly ? RollupTier::Month : RollupTier::Week;
+    int periods = min(SPARKLINE_DAYS / (monthly ? 30 : 7) + 1, getRollupCount(tier));
+    sparkline.begin(periods, sparklineWidth);
+    forEachRecentRollup(tier, periods, [](const RollupRecord& period) {
+      sparkline.addRange(period.low, period.high, period.close);
+    });
+  } else {
+    sparkline.begin(historyCount, sparklineWidth);
+    forEachRecentNetWorth(historyCount, [](const DailyNetWorth& record) {
+      sparkline.add(record.netWorth);
+    });
   }
 
+  // rendering must not touch the heap (checked in debug builds)
+  beginAllocationCount();
+
   display.firstPage();
   do {
     display.fillScreen(GxEPD_WHITE);
@@ -124,17 +214,15 @@ void updateScreen() {
     // header title
     display.setFont(&FreeSansBold24pt7b);
     display.setTextColor(GxEPD_WHITE);
-    drawText(display, headerText.c_str(), 400, bannerHeight / 2, HAlign::Center, VAlign::Center);
+    drawText(display, headerText, 400, bannerHeight / 2, HAlign::Center, VAlign::Center);
 
     // market prices - top right below header
     display.setFont(&FreeSansOblique9pt7b);
     display.setTextColor(GxEPD_BLACK);
     int priceMarginRight = 15;
     int priceStartY = bannerHeight + 6 + 18;  // Below header + accent line + padding
-    String goldText = String("Gold: ") + goldPrice;
-    String btcText = String("Bitcoin: ") + bitcoinPrice;
-    drawText(display, goldText.c_str(), 800 - priceMarginRight, priceStartY, HAlign::Right, VAlign::Top);
-    drawText(display, btcText.c_str(), 800 - priceMarginRight, priceStartY + 22, HAlign::Right, VAlign::Top);
+    drawText(display, goldText, 800 - priceMarginRight, priceStartY, HAlign::Right, VAlign::Top);
+    drawText(display, btcText, 800 - priceMarginRight, priceStartY + 22, HAlign::Right, VAlign::Top);
 
     // low battery warning pill - top left below header
     int warningYOffset = bannerHeight + 6 + 10; // starting Y for warnings area
@@ -171,21 +259,16 @@ void updateScreen() {
     // net worth value - center of screen
     display.setFont(&FreeSansBold48pt7b);
     display.setTextColor(GxEPD_BLACK);
-    String netWorthStr = "N/A";
-    if (netWorth > 0) {
-      netWorthStr = formatCurrency(netWorth);
-    }
-    drawText(display, netWorthStr.c_str(), 400, 240, HAlign::Center, VAlign::Center);
+    drawText(display, netWorthStr, 400, 240, HAlign::Center, VAlign::Center);
 
     // percentage change indicator - centered below net worth
     display.setFont(&FreeSans12pt7b);
     bool isPositive = percentChange >= 0;
     uint16_t changeColor = isPositive ? GxEPD_GREEN : GxEPD_RED;
 
-    String percentText = formatPercentage(percentChange) + " last 24 hours";
     int16_t px1, py1;
     uint16_t ptw, pth;
-    display.getTextBounds(percentText.c_str(), 0, 0, &px1, &py1, &ptw, &pth);
+    display.getTextBounds(percentText, 0, 0, &px1, &py1, &ptw, &pth);
 
     int changeY = 305;
     int triangleSize = 14;
@@ -200,86 +283,152 @@ void updateScreen() {
     // draw percentage text
     display.setTextColor(changeColor);
     int textX = startX + triangleSize + triangleTextGap;
-    drawText(display, percentText.c_str(), textX, changeY, HAlign::Left, VAlign::Center);
+    drawText(display, percentText, textX, changeY, HAlign::Left, VAlign::Center);
 
     // goal projection - centered below percentage text
     display.setFont(&FreeSans12pt7b);
     display.setTextColor(GxEPD_BLACK);
-    String goalProjection = getGoalProjection();
-    if (goalProjection != "") {
-      drawText(display, goalProjection.c_str(), 400, 345, HAlign::Center, VAlign::Center);
+    if (hasGoalProjection) {
+      drawText(display, goalProjection, 400, 345, HAlign::Center, VAlign::Center);
+    }
+
+    // risk statistics - centered below the projection
+    if (hasRisk) {
+      display.setFont(&FreeSansOblique9pt7b);
+      drawText(display, riskText, 400, 370, HAlign::Center, VAlign::Center);
     }
 
     // sparkline - bottom left corner (historical trend)
     if (historyCount >= 7) {
-      drawSparkLine(display, 15, 480 - 10 - 80, 240, 80, sparklineValues, historyCount);
+      drawSparkLine(display, 15, 480 - 10 - 80, sparklineWidth, 80, sparkline);
+    }
+
+    // change panel - bottom, right of the sparkline, one column per window
+    if (hasPanel) {
+      const int columnWidth = 110;
+      const int firstColumnX = 330;
+      for (int i = 0; i < panelCount; i++) {
+        int columnX = firstColumnX + i * columnWidth;
+        display.setFont(&FreeSansOblique9pt7b);
+        display.setTextColor(GxEPD_BLACK);
+        drawText(display, getChangeWindowLabel(panel[i].window), columnX, 395, HAlign::Center, VAlign::Center);
+
+        display.setFont(&FreeSans12pt7b);
+        display.setTextColor(!panel[i].valid ? GxEPD_BLACK : (panel[i].change >= 0 ? GxEPD_GREEN : GxEPD_RED));
+        drawText(display, panelText[i], columnX, 422, HAlign::Center, VAlign::Center);
+      }
     }
 
     // last updated time - bottom right
     display.setFont(&FreeSansOblique9pt7b);
     display.setTextColor(GxEPD_BLACK);
-    String timeStr = getFormattedTime();
-    drawText(display, timeStr.c_str(), 800 - 15, 480 - 10, HAlign::Right, VAlign::Bottom);
+    drawText(display, timeStr, 800 - 15, 480 - 10, HAlign::Right, VAlign::Bottom);
   } while (display.nextPage());
 
-  Serial.println("Refresh Complete!");
+  uint32_t renderAllocations = endAllocationCount();
+  if (renderAllocations > 0) {
+    LOG_ERROR("main", "Render made %u heap allocations", (unsigned)renderAllocations);
+  }
+
+  LOG_INFO("main", "Refresh Complete!");
 }
 
 void setup() {
-  Serial.begin(115200);
-  delay(3000);
-  Serial.println("Waking up...");
+#ifndef RELEASE_BUILD
+  LOG_SERIAL.begin(115200);
+  delay(3000); // give the serial monitor time to attach
+#endif
+  initLog();
+  LOG_INFO("main", "Waking up...");
 
   initBattery();
-  Serial.printf("Battery: %.2fV (%d%%)\n", getBatteryVoltage(), getBatteryPercent());
+  LOG_INFO("power", "Battery: %.2fV (%d%%)", getBatteryVoltage(), getBatteryPercent());
 
   initDatabase();
+  markPhase("boot");
   DailyNetWorth lastStored;
   if (!initialized && getLatestNetWorth(lastStored)) {
     netWorth = lastStored.netWorth;
     initialized = true;
-    Serial.printf("Loaded stored net worth from %s: $%d\n", lastStored.date, netWorth);
+    LOG_INFO("main", "Loaded stored net worth from %s: $%d", lastStored.date, netWorth);
   }
 
   wifiConnected = connectWiFi();
   if (wifiConnected) {
-    syncTime();
+    bool timeSynced = syncTime();
+    markPhase("wifi");
+    beginFetchBudget();
 
     int32_t fetchedNetWorth = fetchNetWorth();
     if (fetchedNetWorth != 0) {
       netWorth = fetchedNetWorth;
       initialized = true;
 
-      saveNetWorth(getFormattedDate().c_str(), netWorth);
-
-      // get percentage change (current day vs previous day)
-      percentChange = getPercentageChange(1);
-      Serial.printf("24h change: %.1f%%\n", percentChange);
+      // without a synced clock the date is "00-00-0000", only the display gets this value
+      if (timeSynced) {
+        char today[FORMATTED_DATE_LEN];
+        saveNetWorth(getFormattedDate(today, sizeof(today)), netWorth);
+        stageAccountSnapshot(today);
+      }
+
+      // largest account moves since the last committed day
+      AccountChange changes[3];
+      int changeCount = getAccountChanges(changes, 3);
+      for (int i = 0; i < changeCount; i++) {
+        LOG_INFO("acct", "%s moved %+d to $%d", changes[i].key, changes[i].change, changes[i].value);
+      }
+
+      // every wake's value goes into the intraday ring, only the last one each day is kept in the daily history
+      uint32_t now = (uint32_t)time(nullptr);
+      if (timeSynced) {
+        addIntradaySample(now, netWorth);
+      }
+
+      // get percentage change over the last 24 hours, or current day vs previous day until the ring reaches back that far
+      // (or when no sample lies within a wake cycle of 24 hours ago, the daily change then labels the real span)
+      percentChangeDays = 1;
+      if (!timeSynced || !getIntradayChange(now, 24 * 3600, SLEEP_DURATION * 60 * 3 / 2, percentChange)) {
+        percentChange = getPercentageChange(1, &percentChangeDays);
+      }
+      LOG_INFO("main", "Change over %d day(s): %.1f%%", percentChangeDays, percentChange);
     } else if (!initialized) {
       // API failed and first boot with no stored data, show 0
       netWorth = 0;
-      Serial.println("API fetch failed on first boot, showing $0");
+      LOG_WARN("main", "API fetch failed on first boot, showing $0");
     } else {
       // API failed but we have a cached value, keep it
-      Serial.printf("API fetch failed, using cached value: $%d\n", netWorth);
+      LOG_WARN("main", "API fetch failed, using cached value: $%d", netWorth);
     }
 
-    String fetchedGold = fetchGoldPrice();
-    if (fetchedGold != "N/A") {
-      strncpy(goldPrice, fetchedGold.c_str(), sizeof(goldPrice) - 1);
-      goldPrice[sizeof(goldPrice) - 1] = '\0';
+    // prices are only overwritten on success, otherwise the last known value stays on screen
+    fetchGoldPrice(goldPrice, sizeof(goldPrice));
+    fetchBitcoinPrice(bitcoinPrice, sizeof(bitcoinPrice));
+
+    // a fresh device reconstructs past history from transactions with whatever network budget is left
+    if (fetchedNetWorth != 0 && timeSynced) {
+      char today[FORMATTED_DATE_LEN];
+      startBackfill(getFormattedDate(today, sizeof(today)), netWorth);
     }
-    String fetchedBtc = fetchBitcoinPrice();
-    if (fetchedBtc != "N/A") {
-      strncpy(bitcoinPrice, fetchedBtc.c_str(), sizeof(bitcoinPrice) - 1);
-      bitcoinPrice[sizeof(bitcoinPrice) - 1] = '\0';
+    if (isBackfillRunning()) {
+      runBackfill();
     }
+    markPhase("fetch");
   } else if (!initialized) {
     // no WiFi and first boot with no stored data
     netWorth = 0;
-    Serial.println("No WiFi on first boot, showing N/A");
+    LOG_WARN("main", "No WiFi on first boot, showing N/A");
   } else {
-    Serial.printf("No WiFi, using cached value: $%d\n", netWorth);
+    LOG_WARN("main", "No WiFi, using cached value: $%d", netWorth);
+  }
+
+  // today's value normally stays in RTC memory until tomorrow, don't risk it on a dying battery
+  // checked on every wake (not only after a successful fetch) and before the power hungry refresh
+  if (isBatteryCritical()) {
+    LOG_WARN("power", "Battery critical, committing today's net worth");
+    commitNetWorth();
+    commitAccountSnapshot();
+    flushIntraday();
+    flushWakeProfiles();
   }
 
   pinMode(EPD_BUSY, INPUT);
@@ -288,18 +437,28 @@ void setup() {
   spi = new SPIClass(FSPI);
   spi->begin(EPD_SCK, -1, EPD_MOSI, EPD_CS);
 
-  Serial.println("Initializing display...");
+  LOG_DEBUG("main", "Initializing display...");
   display.epd2.selectSPI(*spi, SPISettings(4000000, MSBFIRST, SPI_MODE0));
+#ifdef RELEASE_BUILD
+  display.init(0, true, 2, false); // no diagnostics, GxEPD2 would open and print to the UART every wake
+#else
   display.init(115200, true, 2, false);
+#endif
 
   updateScreen();
+  markPhase("render");
 
   // disconnect wifi before sleep to save power
   disconnectWiFi();
+  logFetchStats();
+  logJsonArena();
+  markPhase("sleep");
+  saveWakeProfile();
 }
 
 void loop() {
-  Serial.println("Entering deep sleep for " + String(SLEEP_DURATION) + " minutes...");
+  LOG_INFO("main", "Entering deep sleep for %d minutes...", SLEEP_DURATION);
+  flushLog();
   esp_sleep_enable_timer_wakeup(SLEEP_DURATION_US);
   esp_deep_sleep_start();
 }
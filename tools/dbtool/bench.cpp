@@ -0,0 +1,295 @@
+#include <Arduino.h>
+#include "helpers/accounts.h"
+#include "helpers/database.h"
+#include "helpers/dbmeta.h"
+#include "helpers/calendar.h"
+#include "helpers/classify.h"
+#include "helpers/money.h"
+#include "bench.h"
+#include "stopwatch.h"
+#include <LittleFS.h>
+#include <string>
+#include <vector>
+
+static uint32_t benchSeed = 1;
+
+// deterministic, so runs compare
+static uint32_t nextRandom() {
+  benchSeed = benchSeed * 1103515245u + 12345u;
+  return benchSeed >> 1;
+}
+
+// balance strings as Lunch Money sends them, four decimals, a third of them half a cent past the cents
+static std::vector<std::string> makeBalances(int count) {
+  std::vector<std::string> balances;
+  balances.reserve(count);
+  for (int i = 0; i < count; i++) {
+    char text[24];
+    uint32_t fraction = nextRandom() % 10000;
+    if (i % 3 == 0) {
+      fraction = fraction / 100 * 100 + 50;
+    }
+    snprintf(text, sizeof(text), "%s%u.%04u", i % 5 == 0 ? "-" : "", (unsigned)(nextRandom() % 2000000), (unsigned)fraction);
+    balances.push_back(text);
+  }
+  return balances;
+}
+
+// parseCents with an integer total against the atof and double total it replaced
+static int benchCents(int count) {
+  std::vector<std::string> balances = makeBalances(count);
+
+  Stopwatch doubleTimer;
+  double doubleTotal = 0;
+  for (const std::string& balance : balances) {
+    doubleTotal += atof(balance.c_str());
+  }
+  doubleTimer.report("atof", count, "values");
+
+  Stopwatch centsTimer;
+  int64_t centsTotal = 0;
+  for (const std::string& balance : balances) {
+    int64_t cents;
+    if (parseCents(balance.c_str(), cents)) {
+      centsTotal += cents;
+    }
+  }
+  centsTimer.report("parseCents", count, "values");
+  printf("total:      $%d\n", (int)centsToDollars(centsTotal));
+
+  // values the double path rounds to a different cent, and how far the double sum drifts from the exact one
+  int misrounded = 0;
+  int64_t tenThousandths = 0;
+  for (const std::string& balance : balances) {
+    int64_t cents = 0;
+    parseCents(balance.c_str(), cents);
+    misrounded += doubleToCents(atof(balance.c_str())) != cents;
+
+    std::string digits = balance;
+    digits.erase(digits.find('.'), 1);
+    tenThousandths += strtoll(digits.c_str(), nullptr, 10);
+  }
+
+  printf("double sum: %+.6f cents off the exact sum\n", doubleTotal * 100.0 - tenThousandths / 100.0);
+  printf("misrounded: %d of %d values rounded to another cent through a double\n", misrounded, count);
+  return 0;
+}
+
+// the O(1) projection from the header sums against the point samples it replaced and a full regression pass
+static int benchProjection(int count) {
+  initDatabase();
+  int records = getRecordCount();
+  if (records < 14) {
+    fprintf(stderr, "need at least 14 records, try generate first\n");
+    return 1;
+  }
+
+  char projection[48];
+  Stopwatch sumsTimer;
+  bool projected = false;
+  for (int i = 0; i < count; i++) {
+    projected = getGoalProjection(projection, sizeof(projection));
+  }
+  sumsTimer.report("running sums", count, "projections");
+  printf("projection: %s\n", projected ? projection : "n/a");
+
+  // the reads the old projection made per wake: latest, a year ago and both halves of the growth term
+  int termDays = records >= 730 ? 365 : records >= 365 ? 180 : 90;
+  DailyNetWorth latest;
+  DailyNetWorth yearAgo;
+  DailyNetWorth sample;
+  Stopwatch pointTimer;
+  for (int i = 0; i < count; i++) {
+    getLatestNetWorth(latest);
+    getNetWorthDaysAgo(365, yearAgo);
+    getNetWorthDaysAgo(termDays, sample);
+    getNetWorthDaysAgo(termDays * 2, sample);
+  }
+  pointTimer.report("point samples", count, "projections");
+
+  // least squares straight from the records, what the header sums stand in for
+  int32_t originDay = getDbMeta().originDay;
+  double n = 0, sumT = 0, sumV = 0, sumTT = 0, sumTV = 0;
+  Stopwatch scanTimer;
+  int scanned = forEachStoredNetWorth(INT_MAX, [&](const DailyNetWorth& record) {
+    int32_t day;
+    if (!parseDayNumber(record.date, day)) {
+      return;
+    }
+    double t = day - originDay;
+    n++;
+    sumT += t;
+    sumV += record.netWorth;
+    sumTT += t * t;
+    sumTV += t * record.netWorth;
+  });
+  scanTimer.report("full regression", scanned, "records");
+
+  float slope = 0;
+  float recentSlope = 0;
+  getTrendSlope(false, slope);
+  getTrendSlope(true, recentSlope);
+  double scannedSlope = (n * sumTV - sumT * sumV) / (n * sumTT - sumT * sumT);
+  printf("trend:      $%.2f/day from the sums, $%.2f/day from the scan\n", slope, scannedSlope);
+  printf("recent:     $%.2f/day (half-life %d days)\n", recentSlope, PROJECTION_HALF_LIFE_DAYS);
+  printf("two points: $%.2f/day from the year-ago sample alone\n", (latest.netWorth - yearAgo.netWorth) / 365.0);
+  return 0;
+}
+
+// bytes in the account store, the index included
+static size_t accountStoreBytes() {
+  size_t bytes = 0;
+  File root = LittleFS.open(ACCOUNTS_DIR);
+  File entry;
+  while (root && (entry = root.openNextFile())) {
+    bytes += entry.size();
+    entry.close();
+  }
+  return bytes;
+}
+
+// a simulated account, its balance moves in one of a few typical ways
+struct SimulatedAccount {
+  AccountSource source;
+  uint32_t id;
+  int64_t cents;
+  int style; // 0 spending, 1 investment, 2 credit card, 3 loan, 4 property
+};
+
+// commits years of daily snapshots for ACCOUNTS_MAX / 2 accounts into a fresh account store
+// and reports its size against plain int32 columns as each year completes
+static int benchAccounts(int years) {
+  File root = LittleFS.open(ACCOUNTS_DIR);
+  File entry;
+  std::vector<std::string> stale;
+  while (root && (entry = root.openNextFile())) {
+    stale.push_back(std::string(ACCOUNTS_DIR "/") + entry.name());
+    entry.close();
+  }
+  for (const std::string& path : stale) {
+    LittleFS.remove(path.c_str());
+  }
+
+  std::vector<SimulatedAccount> accounts;
+  for (int i = 0; i < ACCOUNTS_MAX / 2; i++) {
+    int style = i % 5;
+    accounts.push_back({ i % 2 ? AccountSource::Plaid : AccountSource::Manual, 1000u + i, (int64_t)(nextRandom() % 5000000), style });
+  }
+
+  int32_t firstDay = (int32_t)(time(nullptr) / 86400) - years * 365;
+  int days = years * 365;
+  Stopwatch timer;
+  for (int d = 0; d < days; d++) {
+    int32_t day = firstDay + d;
+    beginAccountSnapshot();
+    for (SimulatedAccount& account : accounts) {
+      int64_t move = 0;
+      switch (account.style) {
+        case 0: move = (int64_t)(nextRandom() % 40001) - 20000; break;
+        case 1: move = account.cents / 100 * ((int64_t)(nextRandom() % 201) - 100) / 100; break;
+        case 2: move = nextRandom() % 4 == 0 ? -account.cents / 2 : (int64_t)(nextRandom() % 8000); break;
+        case 3: move = weekdayOf(day) == 0 && nextRandom() % 4 == 0 ? -150000 : 0; break;
+        default: move = nextRandom() % 30 == 0 ? (int64_t)(nextRandom() % 2000001) - 1000000 : 0; break;
+      }
+      account.cents += move;
+      recordAccountBalance(account.source, account.id, account.cents);
+    }
+    endAccountSnapshot(true);
+
+    char date[DATE_LEN];
+    stageAccountSnapshot(formatDayNumber(date, sizeof(date), day));
+    if ((d + 1) % 365 == 0) {
+      commitAccountSnapshot();
+      size_t bytes = accountStoreBytes();
+      size_t plain = (size_t)(d + 1) * sizeof(int32_t) * (accounts.size() + 1);
+      printf("year %2d: %6u bytes, %.2f per account-day (plain int32 columns %u)\n", (d + 1) / 365, (unsigned)bytes, (double)bytes / ((d + 1) * accounts.size()), (unsigned)plain);
+    }
+  }
+  timer.report("commit", days, "days");
+
+  // every column decodes back to the balances that went in
+  int mismatched = 0;
+  for (const SimulatedAccount& account : accounts) {
+    char key[ACCOUNT_KEY_LEN];
+    snprintf(key, sizeof(key), "%c%u", account.source == AccountSource::Manual ? 'a' : 'p', (unsigned)account.id);
+    int32_t last = 0;
+    int rows = forEachAccountBalance(key, [&](int32_t, int32_t value) {
+      last = value;
+    });
+    mismatched += rows != days || last != centsToDollars(account.cents);
+  }
+  printf("verify:     %d of %d columns mismatched\n", mismatched, (int)accounts.size());
+  return mismatched ? 1 : 0;
+}
+
+// the strcmp chains the classifier replaced, manual assets checked three names and plaid accounts two
+static bool isLiabilityByName(const char* type, bool plaid) {
+  if (!type) {
+    return false;
+  }
+  if (plaid) {
+    return strcmp(type, "credit") == 0 || strcmp(type, "loan") == 0;
+  }
+  return strcmp(type, "loan") == 0 || strcmp(type, "credit") == 0 || strcmp(type, "other liability") == 0;
+}
+
+// classifyAccountType() over the type strings of a payload with this many accounts, against the strcmp chains
+static int benchClassify(int count) {
+  // every name Lunch Money sends plus a few it could add later
+  std::vector<const char*> names;
+  for (int type = 0; type < (int)AccountType::Unknown; type++) {
+    names.push_back(getAccountTypeName((AccountType)type));
+  }
+  names.push_back("savings");
+  names.push_back("retirement");
+
+  std::vector<const char*> types;
+  std::vector<bool> plaid;
+  for (int i = 0; i < count; i++) {
+    types.push_back(names[nextRandom() % names.size()]);
+    plaid.push_back(i % 2 == 1);
+  }
+
+  // repeated so a few thousand accounts take long enough to time
+  int passes = max(1, 2000000 / count);
+  long liabilities = 0;
+  Stopwatch classifyTimer;
+  for (int pass = 0; pass < passes; pass++) {
+    for (const char* type : types) {
+      liabilities += isLiabilityType(classifyAccountType(type));
+    }
+  }
+  classifyTimer.report("classify", (long)count * passes, "accounts");
+
+  long byName = 0;
+  Stopwatch strcmpTimer;
+  for (int pass = 0; pass < passes; pass++) {
+    for (int i = 0; i < count; i++) {
+      byName += isLiabilityByName(types[i], plaid[i]);
+    }
+  }
+  strcmpTimer.report("strcmp", (long)count * passes, "accounts");
+
+  // the chains only knew three liability names, the classifier also catches liability subtypes
+  printf("liabilities: %ld classified, %ld by name\n", liabilities / passes, byName / passes);
+  return 0;
+}
+
+int runBench(const char* name, const char* count) {
+  int n = count ? atoi(count) : 0;
+  if (strcmp(name, "cents") == 0) {
+    return benchCents(n > 0 ? n : 100000);
+  }
+  if (strcmp(name, "projection") == 0) {
+    return benchProjection(n > 0 ? n : 10000);
+  }
+  if (strcmp(name, "accounts") == 0) {
+    return benchAccounts(n > 0 ? n : 10);
+  }
+  if (strcmp(name, "classify") == 0) {
+    return benchClassify(n > 0 ? n : 5000);
+  }
+
+  fprintf(stderr, "unknown benchmark \"%s\"\n", name);
+  return 1;
+}
@@ -0,0 +1,8 @@
+#ifndef DBTOOL_BENCH_H
+#define DBTOOL_BENCH_H
+
+// host benchmarks of the firmware helpers behind "dbtool <dir> bench <name> [count]"
+// the host has a double precision FPU, so float and double paths look cheaper here than on the ESP32-S3
+int runBench(const char* name, const char* count);
+
+#endif
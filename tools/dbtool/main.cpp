@@ -0,0 +1,525 @@
+/*
+  dbtool - inspect, compact and generate net worth databases on the host
+
+  builds the firmware's own database code (src/helpers) against the shims in tools/dbtool/shim,
+  operating on a directory holding the contents of the LittleFS partition
+
+    pio run -e dbtool
+    .pio/build/dbtool/program <dir> <command> [args]
+
+  images are unpacked and packed with mklittlefs (installed with the espressif32 platform), either by hand
+  or through -i/-o, which run it before and after the command ($MKLITTLEFS overrides the binary)
+*/
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "helpers/database.h"
+#include "helpers/segment.h"
+#include "helpers/series.h"
+#include "helpers/changes.h"
+#include "helpers/dbmeta.h"
+#include "helpers/rollup.h"
+#include "helpers/calendar.h"
+#include "helpers/profile.h"
+#include "helpers/accounts.h"
+#include "helpers/log.h"
+#include "bench.h"
+#include "stopwatch.h"
+#include <algorithm>
+#include <spawn.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// littlefs partition size in default_8MB.csv, for images packed without one read in first
+#define DBTOOL_IMAGE_SIZE 0x180000
+
+extern int dbtoolLogLevel;
+extern char** environ;
+
+static void usage() {
+  fprintf(
+    stderr,
+    "usage: dbtool [-v] [-i image] [-o image] <dir> <command> [args]\n"
+    "\n"
+    "  -i image                  unpack a LittleFS image into <dir> first\n"
+    "  -o image                  pack <dir> into an image after the command succeeds\n"
+    "\n"
+    "  dump [--csv]              print every stored record, segment by segment, and its crc status (read only)\n"
+    "  query                     latest value, changes, trend and goal projection\n"
+    "  range <from> <to>         low, high and average between two dates (YYYY-MM-DD)\n"
+    "  compact                   drop corrupt, undated and out of order records, rebuild header and rollups\n"
+    "  generate <years> [seed]   replace the database with a synthetic random walk ending today\n"
+    "  wakes                     phase timings and memory of the logged wakes, oldest first (read only)\n"
+    "  account <key>             one account's committed balances, e.g. a123 or p456 (read only)\n"
+    "  bench cents [values]      parseCents and integer sums against atof and double sums over balance strings\n"
+    "  bench projection [count]  goal projection from the header sums against point samples and a full regression\n"
+    "  bench accounts [years]    replace the account store with simulated daily snapshots, reporting its growth\n"
+    "  bench classify [accounts] compile-time account type classifier against the strcmp chains it replaced\n"
+    "\n"
+    "a LittleFS image (e.g. read back with esptool read_flash) can also be unpacked and packed by hand:\n"
+    "  mklittlefs -u <dir> image.bin\n"
+    "  mklittlefs -c <dir> -s <partition size> image.bin\n"
+  );
+}
+
+// segment files, oldest first, read from the directory listing rather than the directory file
+static std::vector<DbSegment> listSegmentFiles() {
+  std::vector<DbSegment> files;
+  File root = LittleFS.open(DB_SEGMENT_DIR);
+  if (!root || !root.isDirectory()) {
+    return files;
+  }
+
+  File entry;
+  while ((entry = root.openNextFile())) {
+    int year;
+    char suffix[5];
+    if (sscanf(entry.name(), "%d.%4s", &year, suffix) == 2 && (strcmp(suffix, "dat") == 0 || strcmp(suffix, "nws") == 0)) {
+      DbSegment segment = {};
+      segment.year = year;
+      segment.format = strcmp(suffix, "nws") == 0 ? SegmentFormat::Series : SegmentFormat::Raw;
+      files.push_back(segment);
+    }
+    entry.close();
+  }
+  std::sort(files.begin(), files.end(), [](const DbSegment& a, const DbSegment& b) { return a.year < b.year; });
+  return files;
+}
+
+// raw records straight from the files, before any recovery, so torn or corrupt ones show up
+// compressed years are decoded block by block, a single file from before segments is dumped as is
+static int dump(bool csv) {
+  std::vector<DbSegment> files;
+  bool single = LittleFS.exists(DB_FILE);
+  if (single) {
+    files.push_back(DbSegment());
+  }
+  for (const DbSegment& segment : listSegmentFiles()) {
+    files.push_back(segment);
+  }
+  if (files.empty()) {
+    fprintf(stderr, "no records in this directory\n");
+    return 1;
+  }
+
+  Stopwatch timer;
+  DailyNetWorth chunk[DB_READ_CHUNK];
+  long count = 0;
+  long corrupt = 0;
+  size_t trailing = 0;
+  size_t bytes = 0;
+  if (csv) {
+    printf("date,net_worth,crc_ok\n");
+  }
+
+  for (size_t i = 0; i < files.size(); i++) {
+    char path[24];
+    bool series = files[i].format == SegmentFormat::Series;
+    if (single && i == 0) {
+      snprintf(path, sizeof(path), DB_FILE);
+    } else {
+      getSegmentPath(path, sizeof(path), files[i].year, files[i].format);
+    }
+
+    File file = LittleFS.open(path, FILE_READ);
+    if (!file) {
+      continue;
+    }
+    if (!csv) {
+      printf("%s\n", path);
+    }
+
+    int got;
+    int position = 0;
+    while ((got = series ? readSeries(file, position, chunk, DB_READ_CHUNK) : file.read((uint8_t*)chunk, sizeof(chunk)) / sizeof(DailyNetWorth)) > 0) {
+      for (int r = 0; r < got; r++) {
+        DailyNetWorth& record = chunk[r];
+        bool valid = isRecordValid(record);
+        record.date[DATE_LEN - 1] = '\0';
+        if (csv) {
+          printf("%s,%d,%d\n", record.date, (int)record.netWorth, valid);
+        } else {
+          printf("%6ld  %s  %12d%s\n", count, record.date, (int)record.netWorth, valid ? "" : "  CRC MISMATCH");
+        }
+        count++;
+        corrupt += !valid;
+      }
+      position += got;
+    }
+
+    bytes += file.size();
+    trailing += file.size() % (series ? SERIES_BLOCK_SIZE : sizeof(DailyNetWorth));
+    file.close();
+  }
+
+  fprintf(
+    stderr,
+    "%ld records in %d files (%u bytes, %.1f per record), %ld corrupt, %u trailing bytes\n",
+    count,
+    (int)files.size(),
+    (unsigned)bytes,
+    count ? (double)bytes / count : 0.0,
+    corrupt,
+    (unsigned)trailing
+  );
+  if (!csv) {
+    timer.report("dump", count, "records");
+  }
+  return 0;
+}
+
+// the wake log written by saveWakeProfile(), one line per phase
+static int wakes() {
+  int count = forEachWakeProfile([](const WakeProfile& profile) {
+    printf("wake %u\n", (unsigned)profile.sequence);
+    for (int i = 0; i < profile.phaseCount; i++) {
+      const PhaseSample& sample = profile.phases[i];
+      printf(
+        "  %-8.*s %6ums  heap %7u (max %7u)  psram %8u  stack %5u\n",
+        PHASE_NAME_LEN,
+        sample.name,
+        (unsigned)sample.ms,
+        (unsigned)sample.freeHeap,
+        (unsigned)sample.largestBlock,
+        (unsigned)sample.freePsram,
+        (unsigned)sample.stackHighWater
+      );
+    }
+  });
+
+  if (count == 0) {
+    fprintf(stderr, "no wake log in this directory\n");
+    return 1;
+  }
+  return 0;
+}
+
+// a column of the per-account store, one line per committed day
+static int account(const char* key) {
+  if (!key) {
+    usage();
+    return 1;
+  }
+
+  Stopwatch timer;
+  int count = forEachAccountBalance(key, [](int32_t day, int32_t value) {
+    char date[DATE_LEN];
+    printf("%s  %12d\n", formatDayNumber(date, sizeof(date), day), (int)value);
+  });
+  if (count == 0) {
+    fprintf(stderr, "no balances for %s\n", key);
+    return 1;
+  }
+  timer.report("account", count, "rows");
+  return 0;
+}
+
+static int query() {
+  DailyNetWorth latest;
+  if (!getLatestNetWorth(latest)) {
+    fprintf(stderr, "database is empty\n");
+    return 1;
+  }
+
+  printf("records:    %d\n", getRecordCount());
+  printf("latest:     %s  $%d\n", latest.date, (int)latest.netWorth);
+
+  int32_t latestDay;
+  if (parseDayNumber(latest.date, latestDay)) {
+    printf("missing:    %d of the last 365 days\n", getMissingDays(latestDay - 364, latestDay));
+  }
+
+  // the span differs from the window when its first day was missed (or history is shorter)
+  const int windows[] = { 1, 7, 30, 365, 3650 };
+  for (int days : windows) {
+    Stopwatch timer;
+    int span = 0;
+    float change = getPercentageChange(days, &span);
+    printf("%5d days:  %+.2f%% over %d days  ", days, change, span);
+    timer.report("lookup", 1, "queries");
+  }
+
+  // the display's change panel, every window from one pass
+  const ChangeWindow windowSet[] = { ChangeWindow::Day, ChangeWindow::Week, ChangeWindow::Month, ChangeWindow::YearToDate, ChangeWindow::Year };
+  WindowChange changes[5];
+  Stopwatch panelTimer;
+  computeChanges(windowSet, 5, changes);
+  printf("panel:     ");
+  for (const WindowChange& change : changes) {
+    if (change.valid) {
+      printf(" %s %+.2f%% (%dd)", getChangeWindowLabel(change.window), change.percent, (int)change.spanDays);
+    } else {
+      printf(" %s n/a", getChangeWindowLabel(change.window));
+    }
+  }
+  printf("  ");
+  panelTimer.report("panel", 1, "queries");
+
+  float slope;
+  if (getTrendSlope(false, slope)) {
+    printf("trend:      $%.2f/day over all history\n", slope);
+  }
+  if (getTrendSlope(true, slope)) {
+    printf("trend:      $%.2f/day recent (half-life %d days)\n", slope, PROJECTION_HALF_LIFE_DAYS);
+  }
+
+  RiskSummary risk;
+  const RiskStats& stats = getDbMeta().risk;
+  if (getRiskSummary(stats, risk)) {
+    char peak[DATE_LEN];
+    char trough[DATE_LEN];
+    formatDayNumber(peak, sizeof(peak), stats.drawdownPeakDay);
+    formatDayNumber(trough, sizeof(trough), stats.drawdownTroughDay);
+    printf("volatility: %.2f%% annualized over %d returns\n", risk.volatility * 100.0f, (int)stats.returns);
+    printf("drawdown:   %.2f%% max (%s to %s), %.2f%% now\n", risk.maxDrawdown * 100.0f, peak, trough, risk.currentDrawdown * 100.0f);
+    if (risk.hasCagr) {
+      printf("cagr:       %+.2f%%\n", risk.cagr * 100.0f);
+    }
+  }
+
+  char projection[48];
+  Stopwatch projectionTimer;
+  bool hasProjection = getGoalProjection(projection, sizeof(projection));
+  printf("projection: %s  ", hasProjection ? projection : "n/a");
+  projectionTimer.report("projection", 1, "queries");
+
+  printf("rollups:    %d weeks, %d months\n", getRollupCount(RollupTier::Week), getRollupCount(RollupTier::Month));
+
+  Stopwatch scanTimer;
+  long visited = forEachRecentNetWorth(INT_MAX, [](const DailyNetWorth&) {});
+  scanTimer.report("scan", visited, "records");
+  return 0;
+}
+
+// summary of the records between two dates (YYYY-MM-DD), streamed through the range iterator
+static int range(const char* from, const char* to) {
+  int32_t fromDay;
+  int32_t toDay;
+  if (!from || !to || !parseIsoDayNumber(from, fromDay) || !parseIsoDayNumber(to, toDay)) {
+    usage();
+    return 1;
+  }
+
+  Stopwatch timer;
+  DailyNetWorth first;
+  DailyNetWorth last;
+  int32_t low = INT32_MAX;
+  int32_t high = INT32_MIN;
+  double sum = 0;
+  int count = forEachNetWorthBetween(fromDay, toDay, [&](const DailyNetWorth& record) {
+    if (low == INT32_MAX) {
+      first = record;
+    }
+    last = record;
+    low = min(low, record.netWorth);
+    high = max(high, record.netWorth);
+    sum += record.netWorth;
+  });
+  timer.report("range", count, "records");
+
+  if (count == 0) {
+    printf("no records between %s and %s\n", from, to);
+    return 0;
+  }
+  printf("records:    %d\n", count);
+  printf("first:      %s  $%d\n", first.date, (int)first.netWorth);
+  printf("last:       %s  $%d\n", last.date, (int)last.netWorth);
+  printf("low/high:   $%d / $%d\n", (int)low, (int)high);
+  printf("average:    $%.0f\n", sum / count);
+  return 0;
+}
+
+static int compact() {
+  Stopwatch timer;
+  int records = getRecordCount();
+  int dropped = compactDatabase();
+  if (dropped < 0) {
+    fprintf(stderr, "compaction failed\n");
+    return 1;
+  }
+
+  printf("dropped %d of %d records\n", dropped, records);
+  timer.report("compact", records, "records");
+  return 0;
+}
+
+static int generate(int years, uint32_t seed) {
+  if (years <= 0) {
+    usage();
+    return 1;
+  }
+
+  // start from nothing, every derived file is rebuilt from the new records
+  const char* files[] = { DB_FILE, DB_JOURNAL_FILE, DB_DIRECTORY_FILE, DB_META_FILE, ROLLUP_WEEK_FILE, ROLLUP_MONTH_FILE };
+  for (const char* path : files) {
+    LittleFS.remove(path);
+  }
+  for (const DbSegment& segment : listSegmentFiles()) {
+    char path[24];
+    LittleFS.remove(getSegmentPath(path, sizeof(path), segment.year, segment.format));
+  }
+  initDatabase();
+
+  long total = (long)years * 365;
+  int32_t firstDay = (int32_t)(time(nullptr) / 86400) - total + 1;
+
+  // log-normal random walk, ~7% a year with ~15% volatility, plus steady savings
+  srand(seed);
+  double value = 25000.0;
+  long generated = 0;
+
+  Stopwatch timer;
+  int added = prependNetWorthHistory([&](DailyNetWorth* chunk, int maxRecords) {
+    int count = 0;
+    while (count < maxRecords && generated < total) {
+      double noise = ((double)rand() / RAND_MAX - 0.5) * 2.0 * 0.0136;
+      value = value * (1.0 + 0.00019 + noise) + 40.0;
+
+      DailyNetWorth& record = chunk[count++];
+      memset(&record, 0, sizeof(DailyNetWorth));
+      formatDayNumber(record.date, DATE_LEN, firstDay + generated);
+      record.netWorth = (int32_t)lround(value);
+      generated++;
+    }
+    return count;
+  });
+
+  if (added < 0) {
+    fprintf(stderr, "generation failed\n");
+    return 1;
+  }
+
+  timer.report("generate", added, "records");
+  size_t bytes = 0;
+  for (const DbSegment& segment : listSegmentFiles()) {
+    char path[24];
+    File file = LittleFS.open(getSegmentPath(path, sizeof(path), segment.year, segment.format), FILE_READ);
+    bytes += file ? file.size() : 0;
+  }
+  printf("%d segments in " DB_SEGMENT_DIR ", %u bytes (%u as raw records)\n", getSegmentCount(), (unsigned)bytes, (unsigned)(added * sizeof(DailyNetWorth)));
+  return 0;
+}
+
+// run mklittlefs with the given arguments, returns true if it exited cleanly
+static bool runMklittlefs(std::vector<const char*> args) {
+  const char* tool = getenv("MKLITTLEFS") ? getenv("MKLITTLEFS") : "mklittlefs";
+  args.insert(args.begin(), tool);
+  args.push_back(nullptr);
+
+  pid_t pid;
+  int status;
+  if (posix_spawnp(&pid, tool, nullptr, nullptr, (char* const*)args.data(), environ) != 0 || waitpid(pid, &status, 0) < 0) {
+    fprintf(stderr, "can't run %s, install it or set MKLITTLEFS\n", tool);
+    return false;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// an image path that still works after chdir into <dir>
+static std::string absolutePath(const char* path) {
+  if (path[0] == '/') {
+    return path;
+  }
+  char cwd[PATH_MAX];
+  return std::string(getcwd(cwd, sizeof(cwd)) ? cwd : ".") + "/" + path;
+}
+
+static int run(const char* command, int arg, int argc, char** argv) {
+  if (strcmp(command, "dump") == 0) {
+    return dump(arg < argc && strcmp(argv[arg], "--csv") == 0);
+  }
+  if (strcmp(command, "wakes") == 0) {
+    return wakes();
+  }
+  if (strcmp(command, "account") == 0) {
+    return account(arg < argc ? argv[arg] : nullptr);
+  }
+  if (strcmp(command, "bench") == 0) {
+    return runBench(arg < argc ? argv[arg] : "", arg + 1 < argc ? argv[arg + 1] : nullptr);
+  }
+
+  // everything else goes through the same mount path as the firmware, including journal and tail recovery
+  Stopwatch mountTimer;
+  initDatabase();
+  mountTimer.report("mount", 1, "mounts");
+
+  if (strcmp(command, "query") == 0) {
+    return query();
+  }
+  if (strcmp(command, "range") == 0) {
+    return range(arg < argc ? argv[arg] : nullptr, arg + 1 < argc ? argv[arg + 1] : nullptr);
+  }
+  if (strcmp(command, "compact") == 0) {
+    return compact();
+  }
+  if (strcmp(command, "generate") == 0) {
+    int years = arg < argc ? atoi(argv[arg]) : 0;
+    uint32_t seed = arg + 1 < argc ? strtoul(argv[arg + 1], nullptr, 10) : 1;
+    return generate(years, seed);
+  }
+
+  usage();
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  int arg = 1;
+  const char* imageIn = nullptr;
+  const char* imageOut = nullptr;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    if (strcmp(argv[arg], "-v") == 0) {
+      dbtoolLogLevel = LOG_LEVEL_DEBUG;
+    } else if (strcmp(argv[arg], "-i") == 0 && arg + 1 < argc) {
+      imageIn = argv[++arg];
+    } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+      imageOut = argv[++arg];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (argc - arg < 2) {
+    usage();
+    return 1;
+  }
+
+  const char* dir = argv[arg++];
+  const char* command = argv[arg++];
+
+  // the packed image keeps the size of the one read in, so it still fits the partition it came from
+  size_t imageSize = DBTOOL_IMAGE_SIZE;
+  if (imageIn) {
+    struct stat info;
+    if (stat(imageIn, &info) != 0) {
+      fprintf(stderr, "can't open %s\n", imageIn);
+      return 1;
+    }
+    imageSize = info.st_size;
+    mkdir(dir, 0755);
+    if (!runMklittlefs({ "-u", dir, imageIn })) {
+      fprintf(stderr, "failed to unpack %s\n", imageIn);
+      return 1;
+    }
+  }
+  std::string imageOutPath = imageOut ? absolutePath(imageOut) : "";
+
+  if (chdir(dir) != 0) {
+    fprintf(stderr, "can't open %s\n", dir);
+    return 1;
+  }
+
+  int result = run(command, arg, argc, argv);
+  if (result == 0 && imageOut) {
+    char size[16];
+    snprintf(size, sizeof(size), "%u", (unsigned)imageSize);
+    if (!runMklittlefs({ "-c", ".", "-s", size, imageOutPath.c_str() })) {
+      fprintf(stderr, "failed to pack %s\n", imageOut);
+      return 1;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,58 @@
+#ifndef DBTOOL_SHIM_ARDUINO_H
+#define DBTOOL_SHIM_ARDUINO_H
+
+// just enough of the Arduino core for the database and fetch helpers to build on the host
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#define RTC_DATA_ATTR
+
+using std::min;
+using std::max;
+
+uint32_t millis();
+void delay(uint32_t ms);
+uint32_t esp_random();
+
+// local time from the host clock
+bool getLocalTime(struct tm* info, uint32_t ms = 5000);
+
+// no PSRAM on the host, the JSON arena comes from the heap
+inline bool psramFound() { return false; }
+inline void* ps_malloc(size_t size) { return malloc(size); }
+
+// no heap statistics on the host, wake profiles are only read back
+struct EspClass {
+  uint32_t getFreeHeap() { return 0; }
+  uint32_t getMaxAllocHeap() { return 0; }
+  uint32_t getFreePsram() { return 0; }
+};
+extern EspClass ESP;
+inline uint32_t uxTaskGetStackHighWaterMark(void*) { return 0; }
+
+// byte source the fetch handlers and ArduinoJson (ARDUINOJSON_ENABLE_ARDUINO_STREAM) read response bodies from
+class Stream {
+ public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    int c;
+    while (count < length && (c = read()) >= 0) {
+      buffer[count++] = (char)c;
+    }
+    return count;
+  }
+};
+
+#endif
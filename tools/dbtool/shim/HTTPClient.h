@@ -0,0 +1,10 @@
+#ifndef DBTOOL_SHIM_HTTPCLIENT_H
+#define DBTOOL_SHIM_HTTPCLIENT_H
+
+// the HTTP codes the fetch executor and transports return, there is no network client on the host
+
+#define HTTP_CODE_OK 200
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef DBTOOL_SHIM_LITTLEFS_H
+#define DBTOOL_SHIM_LITTLEFS_H
+
+#include <Arduino.h>
+#include <dirent.h>
+#include <memory>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+// Arduino fs::File over stdio (or a directory listing), copies share the handle like the real one
+class File : public Stream {
+ public:
+  File() {}
+  File(FILE* fp, const char* path) : handle(fp, fclose), path(path) {}
+  File(DIR* dp, const char* path) : directory(dp, closedir), path(path) {}
+
+  size_t read(uint8_t* buffer, size_t size) { return handle ? fread(buffer, 1, size, handle.get()) : 0; }
+  int read() override {
+    int c = handle ? fgetc(handle.get()) : EOF;
+    return c == EOF ? -1 : c;
+  }
+  int peek() override {
+    int c = handle ? fgetc(handle.get()) : EOF;
+    if (c == EOF) {
+      return -1;
+    }
+    ungetc(c, handle.get());
+    return c;
+  }
+  int available() override { return handle ? (int)(size() - position()) : 0; }
+  size_t readBytes(char* buffer, size_t size) override { return read((uint8_t*)buffer, size); }
+  size_t write(const uint8_t* buffer, size_t size) { return handle ? fwrite(buffer, 1, size, handle.get()) : 0; }
+  bool seek(uint32_t position) { return handle && fseek(handle.get(), position, SEEK_SET) == 0; }
+  size_t position() const { return handle ? ftell(handle.get()) : 0; }
+  size_t size() const;
+  void close() {
+    handle.reset();
+    directory.reset();
+  }
+  operator bool() const { return handle || directory; }
+
+  // directory listing, names are the entry's own name like the arduino-esp32 2.x core
+  bool isDirectory() const { return (bool)directory; }
+  File openNextFile();
+  const char* name() const;
+
+ private:
+  std::shared_ptr<FILE> handle;
+  std::shared_ptr<DIR> directory;
+  std::string path;
+};
+
+// paths are resolved against the working directory, which dbtool sets to the unpacked image
+class LittleFSShim {
+ public:
+  bool begin() { return true; }
+  File open(const char* path, const char* mode = FILE_READ);
+  bool exists(const char* path);
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+  bool mkdir(const char* path);
+  size_t totalBytes() { return 0; }
+  size_t usedBytes() { return 0; }
+};
+
+extern LittleFSShim LittleFS;
+
+#endif
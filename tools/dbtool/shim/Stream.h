@@ -0,0 +1,7 @@
+#ifndef DBTOOL_SHIM_STREAM_H
+#define DBTOOL_SHIM_STREAM_H
+
+// ArduinoJson's stream reader includes the core's Stream.h directly
+#include "Arduino.h"
+
+#endif
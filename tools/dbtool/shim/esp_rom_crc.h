@@ -0,0 +1,9 @@
+#ifndef DBTOOL_SHIM_ESP_ROM_CRC_H
+#define DBTOOL_SHIM_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// same result as the ESP32 ROM routine (and zlib's crc32)
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buffer, uint32_t length);
+
+#endif
@@ -0,0 +1,131 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <esp_rom_crc.h>
+#include "helpers/log.h"
+#include <chrono>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LittleFSShim LittleFS;
+EspClass ESP;
+
+// LOG_* output, warnings and errors unless dbtool was started with -v
+int dbtoolLogLevel = LOG_LEVEL_WARN;
+
+uint32_t millis() {
+  using namespace std::chrono;
+  static const steady_clock::time_point start = steady_clock::now();
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+void delay(uint32_t ms) {
+  usleep(ms * 1000);
+}
+
+uint32_t esp_random() {
+  return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+bool getLocalTime(struct tm* info, uint32_t) {
+  time_t now = time(nullptr);
+  return localtime_r(&now, info) != nullptr;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buffer, uint32_t length) {
+  static uint32_t table[256];
+  if (!table[1]) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c >> 1) ^ (0xEDB88320 & -(c & 1));
+      }
+      table[i] = c;
+    }
+  }
+
+  crc = ~crc;
+  while (length--) {
+    crc = table[(crc ^ *buffer++) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void logWrite(uint8_t level, const char* tag, const char* format, ...) {
+  if (level > dbtoolLogLevel) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "[%s] ", tag);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+// firmware paths are absolute ("/networth.dat"), on the host they are relative to the image directory
+static const char* hostPath(const char* path) {
+  return path[0] == '/' ? path + 1 : path;
+}
+
+size_t File::size() const {
+  if (!handle) {
+    return 0;
+  }
+  struct stat info;
+  fflush(handle.get());
+  return fstat(fileno(handle.get()), &info) == 0 ? info.st_size : 0;
+}
+
+const char* File::name() const {
+  size_t slash = path.rfind('/');
+  return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+File File::openNextFile() {
+  struct dirent* entry;
+  while (directory && (entry = readdir(directory.get()))) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+      return LittleFS.open((path + "/" + entry->d_name).c_str());
+    }
+  }
+  return File();
+}
+
+File LittleFSShim::open(const char* path, const char* mode) {
+  // fopen succeeds on directories, the firmware opens them to list their files
+  struct stat info;
+  if (strcmp(mode, "r") == 0 && stat(hostPath(path), &info) == 0 && S_ISDIR(info.st_mode)) {
+    DIR* dp = opendir(hostPath(path));
+    return dp ? File(dp, path) : File();
+  }
+
+  const char* hostMode = "rb";
+  if (strcmp(mode, "w") == 0) {
+    hostMode = "wb";
+  } else if (strcmp(mode, "a") == 0) {
+    hostMode = "ab";
+  } else if (strcmp(mode, "r+") == 0) {
+    hostMode = "r+b";
+  }
+
+  FILE* fp = fopen(hostPath(path), hostMode);
+  return fp ? File(fp, path) : File();
+}
+
+bool LittleFSShim::exists(const char* path) {
+  return access(hostPath(path), F_OK) == 0;
+}
+
+bool LittleFSShim::remove(const char* path) {
+  return ::remove(hostPath(path)) == 0;
+}
+
+bool LittleFSShim::rename(const char* from, const char* to) {
+  return ::rename(hostPath(from), hostPath(to)) == 0;
+}
+
+bool LittleFSShim::mkdir(const char* path) {
+  return ::mkdir(hostPath(path), 0755) == 0;
+}
@@ -0,0 +1,29 @@
+#ifndef DBTOOL_STOPWATCH_H
+#define DBTOOL_STOPWATCH_H
+
+#include <chrono>
+#include <stdio.h>
+
+// wall clock for throughput figures
+class Stopwatch {
+ public:
+  Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+  void report(const char* operation, long count, const char* unit) const {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf(
+      "%s: %ld %s in %.3f ms (%.0f %s/s)\n",
+      operation,
+      count,
+      unit,
+      seconds * 1000.0,
+      seconds > 0 ? count / seconds : 0.0,
+      unit
+    );
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,205 @@
+/*
+  fetchbench - run the firmware's fetch, parse and sum path on the host over generated payloads
+
+  builds src/helpers (api, fetch, transport, money, classify, plaidsync, accounts, arena) against the shims in
+  tools/dbtool/shim, requests go through FixtureTransport reading <dir>/fixtures like -DAPI_FIXTURES on the device
+
+    pio run -e fetchbench
+    .pio/build/fetchbench/program <dir> [accounts ...]
+
+  for each account count (5 50 500 5000 by default) half manual assets and half plaid accounts are written as
+  fixtures, fetchNetWorth() is checked against the total computed here and timed cold (new plaid accounts) and
+  warm (unchanged payload, plaid accounts already in the sync table), then a server slower than the wake
+  budget is checked to be abandoned within it
+*/
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "helpers/api.h"
+#include "helpers/arena.h"
+#include "helpers/fetch.h"
+#include "helpers/log.h"
+#include "helpers/money.h"
+#include "helpers/transport.h"
+#include <chrono>
+#include <string>
+#include <unistd.h>
+
+extern int dbtoolLogLevel;
+
+static FixtureTransport fixtures;
+
+static const char* manualTypes[] = { "cash", "investment", "credit", "loan", "real estate", "other liability", "vehicle" };
+static const bool manualLiability[] = { false, false, true, true, false, true, false };
+static const char* plaidTypes[] = { "depository", "credit", "loan", "investment" };
+static const char* plaidSubtypes[] = { "checking", "credit card", "student", "brokerage" };
+static const bool plaidLiability[] = { false, true, true, false };
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// amount in ten-thousandths as Lunch Money sends it ("-1234.5678"), returns the cents parseCents() rounds it to
+static int64_t appendAmount(std::string& out, int64_t tenThousandths) {
+  char text[32];
+  int64_t magnitude = llabs(tenThousandths);
+  snprintf(text, sizeof(text), "\"%s%lld.%04lld\"", tenThousandths < 0 ? "-" : "", (long long)(magnitude / 10000), (long long)(magnitude % 10000));
+  out += text;
+
+  int64_t cents = magnitude / 100 + (magnitude % 100 >= 50 ? 1 : 0);
+  return tenThousandths < 0 ? -cents : cents;
+}
+
+static void appendCents(std::string& out, int64_t cents) {
+  char text[32];
+  snprintf(text, sizeof(text), "%s%lld.%02lld", cents < 0 ? "-" : "", (long long)(llabs(cents) / 100), (long long)(llabs(cents) % 100));
+  out += text;
+}
+
+// one account with the fields Lunch Money sends, returns its signed contribution in cents (0 when closed)
+static int64_t appendAccount(std::string& out, bool plaid, uint32_t id, uint32_t& seed) {
+  seed = seed * 1103515245u + 12345u;
+  int kind = (seed >> 8) % (plaid ? 4 : 7);
+  bool closed = (seed >> 4) % 23 == 0;
+  bool converted = (seed >> 12) % 3 == 0;
+  int64_t raw = (int64_t)(seed % 50000000u) - 5000000; // -500.0000 to 4500.0000
+
+  char text[160];
+  snprintf(text, sizeof(text), "%s{\"id\":%u,\"name\":\"Account %u\",", out.back() == '[' ? "" : ",", (unsigned)id, (unsigned)id);
+  out += text;
+  if (plaid) {
+    snprintf(text, sizeof(text), "\"type\":\"%s\",\"subtype\":\"%s\",\"mask\":\"%04u\",\"status\":\"active\",", plaidTypes[kind], plaidSubtypes[kind], (unsigned)(id % 10000));
+    out += text;
+    out += "\"balance_last_update\":null,\"last_import\":\"2026-10-19T08:00:00.000Z\",";
+  } else {
+    snprintf(text, sizeof(text), "\"type_name\":\"%s\",\"subtype_name\":null,\"display_name\":null,", manualTypes[kind]);
+    out += text;
+  }
+
+  out += "\"balance\":";
+  int64_t cents = appendAmount(out, raw);
+  if (converted) {
+    cents = cents * 9 / 10;
+    out += ",\"to_base\":";
+    appendCents(out, cents);
+  }
+  out += ",\"currency\":\"usd\",\"institution_name\":\"Bank\",\"created_at\":\"2024-01-01T00:00:00.000Z\",\"closed_on\":";
+  out += closed ? "\"2025-06-30\"}" : "null}";
+
+  if (closed) {
+    return 0;
+  }
+  bool liability = plaid ? plaidLiability[kind] : manualLiability[kind];
+  return liability ? -llabs(cents) : cents;
+}
+
+// write both fixtures, returns the expected net worth in cents
+static int64_t writeFixtures(int accounts, uint32_t firstId, size_t& bytes) {
+  uint32_t seed = firstId;
+  int64_t expected = 0;
+  bytes = 0;
+
+  for (int plaid = 0; plaid < 2; plaid++) {
+    int count = plaid ? accounts - accounts / 2 : accounts / 2;
+    std::string body = plaid ? "{\"plaid_accounts\":[" : "{\"assets\":[";
+    for (int i = 0; i < count; i++) {
+      expected += appendAccount(body, plaid, firstId + plaid * accounts + i, seed);
+    }
+    body += "]}";
+
+    char path[48];
+    snprintf(path, sizeof(path), FIXTURE_DIR "/%s.json", getEndpointName(plaid ? FetchEndpoint::Plaid : FetchEndpoint::Assets));
+    File file = LittleFS.open(path, FILE_WRITE);
+    file.write((const uint8_t*)body.data(), body.size());
+    file.close();
+    bytes += body.size();
+  }
+  return expected;
+}
+
+static bool bench(int accounts) {
+  // fresh ids per run, so the first fetch finds none of them in the plaid table
+  size_t bytes;
+  int64_t expected = writeFixtures(accounts, (uint32_t)accounts * 100, bytes);
+  int32_t expectedDollars = centsToDollars(expected);
+
+  auto start = std::chrono::steady_clock::now();
+  beginFetchBudget();
+  int32_t cold = fetchNetWorth();
+  double coldSeconds = secondsSince(start);
+
+  // enough warm runs to time
+  int runs = max(3, 200000 / accounts);
+  bool ok = cold == expectedDollars;
+  size_t spilledBefore = jsonArena.spilledBytes();
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; i++) {
+    beginFetchBudget();
+    ok = fetchNetWorth() == expectedDollars && ok;
+  }
+  double warmSeconds = secondsSince(start) / runs;
+
+  printf(
+    "%5d accounts, %7u bytes: cold %.3f ms, warm %.3f ms (%.0f accounts/s, %.1f MB/s), arena peak %u of %u, %u spilled/run, total %s\n",
+    accounts,
+    (unsigned)bytes,
+    coldSeconds * 1000.0,
+    warmSeconds * 1000.0,
+    accounts / warmSeconds,
+    bytes / warmSeconds / 1e6,
+    (unsigned)jsonArena.highWaterMark(),
+    (unsigned)jsonArena.capacity(),
+    (unsigned)((jsonArena.spilledBytes() - spilledBefore) / runs),
+    ok ? "ok" : "MISMATCH"
+  );
+  if (!ok) {
+    printf("  expected $%d, got $%d\n", expectedDollars, cold);
+  }
+  return ok;
+}
+
+// a server that never answers within the budget has to be given up on before the budget runs out
+static bool deadline() {
+  const uint32_t budget = 1000;
+  fixtures.setLatency(FETCH_CONNECT_TIMEOUT_MS + 1, 0);
+
+  auto start = std::chrono::steady_clock::now();
+  beginFetchBudget(budget);
+  int32_t netWorth = fetchNetWorth();
+  double elapsed = secondsSince(start) * 1000.0;
+  fixtures.setLatency(0, 0);
+
+  bool ok = netWorth == 0 && elapsed < budget * 1.2;
+  printf("deadline: %.0f ms for a %u ms budget, %s\n", elapsed, (unsigned)budget, ok ? "ok" : "OVERRUN");
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: fetchbench <dir> [accounts ...]\n");
+    return 1;
+  }
+  if (chdir(argv[1]) != 0) {
+    fprintf(stderr, "can't open %s\n", argv[1]);
+    return 1;
+  }
+
+  // more than ACCOUNTS_MAX accounts warn once each, only errors are interesting here
+  dbtoolLogLevel = LOG_LEVEL_ERROR;
+  LittleFS.mkdir(FIXTURE_DIR);
+  setTransport(&fixtures);
+
+  bool ok = true;
+  if (argc > 2) {
+    for (int i = 2; i < argc; i++) {
+      ok = bench(atoi(argv[i])) && ok;
+    }
+  } else {
+    for (int accounts : { 5, 50, 500, 5000 }) {
+      ok = bench(accounts) && ok;
+    }
+  }
+
+  ok = deadline() && ok;
+  return ok ? 0 : 1;
+}